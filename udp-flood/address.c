@@ -0,0 +1,210 @@
+#include "./address.h"
+#include "./random.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#undef countof
+#define countof(_x) (sizeof((_x)) / sizeof((_x)[0]))
+
+static bool address_replace_stars(char *buffer, size_t buffer_length, const char *address, const char *replacement);
+static unsigned int address_count_bits(uint32_t value);
+static uint32_t address_deposit(uint32_t mask, uint64_t *value);
+
+int address_range_parse(address_range_t *range, const char *address, bool is_ipv4) {
+  assert(NULL != range);
+  assert(NULL != address);
+
+  memset(range, 0, sizeof(*range));
+
+  int family = is_ipv4 ? AF_INET : AF_INET6;
+  size_t address_size = is_ipv4 ? 4 : 16;
+
+  char text[256] = {0};
+  const char *prefix = strchr(address, '/');
+  size_t text_length = prefix ? (size_t)(prefix - address) : strlen(address);
+  if (text_length >= countof(text)) {
+    return UV_EINVAL;
+  }
+  memcpy(text, address, text_length);
+
+  // '*' is the whole octet (IPv4) or hextet (IPv6), so the mask is the difference between the lowest and the highest values
+  char lowest_text[256] = {0};
+  char highest_text[256] = {0};
+  if (!address_replace_stars(lowest_text, countof(lowest_text), text, "0") ||
+      !address_replace_stars(highest_text, countof(highest_text), text, is_ipv4 ? "255" : "ffff")) {
+    return UV_EINVAL;
+  }
+
+  uint32_t lowest[4] = {0};
+  uint32_t highest[4] = {0};
+  if (0 != uv_inet_pton(family, lowest_text, lowest)) {
+    return prefix ? UV_EINVAL : UV_EAI_NONAME;
+  } else if (0 != uv_inet_pton(family, highest_text, highest)) {
+    return UV_EINVAL;
+  }
+
+  uint8_t mask[16] = {0};
+  if (prefix) {
+    char *end = NULL;
+    long prefix_length = strtol(prefix + 1, &end, 10);
+    if (end == prefix + 1 || 0 != *end || prefix_length < 0 || prefix_length > (long)address_size * 8) {
+      return UV_EINVAL;
+    }
+
+    size_t bit = 0;
+    for (bit = (size_t)prefix_length; bit < address_size * 8; ++bit) {
+      mask[bit / 8] |= (uint8_t)(0x80 >> (bit % 8));
+    }
+  }
+
+  size_t word = 0;
+  for (word = 0; word < address_size / 4; ++word) {
+    uint32_t prefix_mask = 0;
+    memcpy(&prefix_mask, mask + word * 4, 4);
+
+    range->mask[word] = (lowest[word] ^ highest[word]) | prefix_mask;
+    range->bits += address_count_bits(range->mask[word]);
+
+    lowest[word] &= ~range->mask[word];
+  }
+
+  if (is_ipv4) {
+    range->base.addr4.sin_family = AF_INET;
+    memcpy(&range->base.addr4.sin_addr, lowest, address_size);
+  } else {
+    range->base.addr6.sin6_family = AF_INET6;
+    memcpy(&range->base.addr6.sin6_addr, lowest, address_size);
+  }
+
+  return 0;
+}
+
+void address_range_random(const address_range_t *range, int port, sockaddr_any *sockaddr) {
+  assert(NULL != range);
+  assert(NULL != sockaddr);
+
+  if (AF_INET == range->base.addr.sa_family) {
+    sockaddr->addr4 = range->base.addr4;
+    sockaddr->addr4.sin_port = htons((uint16_t)port);
+
+    if (range->mask[0]) {
+      sockaddr->addr4.sin_addr.s_addr |= random_next() & range->mask[0];
+    }
+  } else {
+    sockaddr->addr6 = range->base.addr6;
+    sockaddr->addr6.sin6_port = htons((uint16_t)port);
+
+    uint32_t words[4];
+    memcpy(words, &sockaddr->addr6.sin6_addr, sizeof(words));
+
+    size_t word = 0;
+    for (word = 0; word < countof(words); ++word) {
+      if (range->mask[word]) {
+        words[word] |= random_next() & range->mask[word];
+      }
+    }
+
+    memcpy(&sockaddr->addr6.sin6_addr, words, sizeof(words));
+  }
+}
+
+void address_range_at(const address_range_t *range, uint64_t index, int port, sockaddr_any *sockaddr) {
+  assert(NULL != range);
+  assert(NULL != sockaddr);
+
+  if (AF_INET == range->base.addr.sa_family) {
+    sockaddr->addr4 = range->base.addr4;
+    sockaddr->addr4.sin_port = htons((uint16_t)port);
+    sockaddr->addr4.sin_addr.s_addr |= htonl(address_deposit(ntohl(range->mask[0]), &index));
+  } else {
+    sockaddr->addr6 = range->base.addr6;
+    sockaddr->addr6.sin6_port = htons((uint16_t)port);
+
+    uint32_t words[4];
+    memcpy(words, &sockaddr->addr6.sin6_addr, sizeof(words));
+
+    // the lowest bits of the index go to the last word
+    size_t word = countof(words);
+    while (word-- > 0) {
+      if (range->mask[word]) {
+        words[word] |= htonl(address_deposit(ntohl(range->mask[word]), &index));
+      }
+    }
+
+    memcpy(&sockaddr->addr6.sin6_addr, words, sizeof(words));
+  }
+}
+
+bool address_equal(const sockaddr_any *left, const sockaddr_any *right) {
+  assert(NULL != left);
+  assert(NULL != right);
+
+  if (left->addr.sa_family != right->addr.sa_family) {
+    return false;
+  } else if (AF_INET == left->addr.sa_family) {
+    return left->addr4.sin_port == right->addr4.sin_port &&
+           0 == memcmp(&left->addr4.sin_addr, &right->addr4.sin_addr, sizeof(left->addr4.sin_addr));
+  }
+
+  return left->addr6.sin6_port == right->addr6.sin6_port &&
+         0 == memcmp(&left->addr6.sin6_addr, &right->addr6.sin6_addr, sizeof(left->addr6.sin6_addr));
+}
+
+void address_format(const sockaddr_any *sockaddr, char *buffer, size_t buffer_length) {
+  assert(NULL != sockaddr);
+  assert(NULL != buffer);
+
+  char name[64] = {0};
+
+  if (AF_INET == sockaddr->addr.sa_family) {
+    uv_ip4_name(&sockaddr->addr4, name, countof(name));
+    sprintf_s(buffer, buffer_length, "%s %d", name, (int)ntohs(sockaddr->addr4.sin_port));
+  } else {
+    uv_ip6_name(&sockaddr->addr6, name, countof(name));
+    sprintf_s(buffer, buffer_length, "%s %d", name, (int)ntohs(sockaddr->addr6.sin6_port));
+  }
+}
+
+static bool address_replace_stars(char *buffer, size_t buffer_length, const char *address, const char *replacement) {
+  size_t replacement_length = strlen(replacement);
+  size_t length = 0;
+
+  for (; *address; ++address) {
+    const char *source = ('*' == *address) ? replacement : address;
+    size_t source_length = ('*' == *address) ? replacement_length : 1;
+
+    if (length + source_length >= buffer_length) {
+      return false;
+    }
+
+    memcpy(buffer + length, source, source_length);
+    length += source_length;
+  }
+
+  buffer[length] = 0;
+  return true;
+}
+
+static unsigned int address_count_bits(uint32_t value) {
+  unsigned int count = 0;
+  for (; value; value &= value - 1) {
+    ++count;
+  }
+  return count;
+}
+
+static uint32_t address_deposit(uint32_t mask, uint64_t *value) {
+  uint32_t result = 0;
+
+  // scatter the lowest bits of the value into the set bits of the mask, from the lowest one
+  for (; mask; mask &= mask - 1) {
+    if (*value & 1) {
+      result |= mask & (~mask + 1);
+    }
+    *value >>= 1;
+  }
+
+  return result;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <uv.h>
+
+typedef union _sockaddr_any {
+  struct sockaddr addr;
+  struct sockaddr_in addr4;
+  struct sockaddr_in6 addr6;
+} sockaddr_any;
+
+typedef struct _address_range_t {
+  // address with zero port and zero variable bits
+  sockaddr_any base;
+  // variable bits of the address in network order, one word for IPv4 and four words for IPv6
+  uint32_t mask[4];
+  // count of variable bits
+  unsigned int bits;
+} address_range_t;
+
+extern int address_range_parse(address_range_t *range, const char *address, bool is_ipv4);
+
+extern void address_range_random(const address_range_t *range, int port, sockaddr_any *sockaddr);
+
+// the lowest bits of the index fill the variable bits, so consecutive indexes give different addresses
+extern void address_range_at(const address_range_t *range, uint64_t index, int port, sockaddr_any *sockaddr);
+
+// the family, the address and the port are compared
+extern bool address_equal(const sockaddr_any *left, const sockaddr_any *right);
+
+extern void address_format(const sockaddr_any *sockaddr, char *buffer, size_t buffer_length);
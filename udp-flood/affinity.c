@@ -0,0 +1,224 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// sched_setaffinity is a GNU extension
+#define _GNU_SOURCE
+#endif /*__linux__*/
+
+#include "./affinity.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <uv.h>
+
+int affinity_parse_list(const char *list, unsigned int *items, size_t items_max, size_t *items_count) {
+  assert(NULL != list);
+  assert(NULL != items);
+  assert(NULL != items_count);
+
+  *items_count = 0;
+
+  // sysfs lists end with a new line, the list of a node without CPUs is empty
+  const char *range = list;
+  while (0 != *range && '\n' != *range) {
+    char *end = NULL;
+    unsigned long first = strtoul(range, &end, 10);
+    if (end == range) {
+      return UV_EINVAL;
+    }
+
+    unsigned long last = first;
+    if ('-' == *end) {
+      range = end + 1;
+      last = strtoul(range, &end, 10);
+      if (end == range || last < first) {
+        return UV_EINVAL;
+      }
+    }
+
+    unsigned long item = 0;
+    for (item = first; item <= last; ++item) {
+      if (*items_count >= items_max) {
+        return UV_E2BIG;
+      }
+
+      items[(*items_count)++] = (unsigned int)item;
+    }
+
+    if (',' == *end) {
+      ++end;
+    } else if (0 != *end && '\n' != *end) {
+      return UV_EINVAL;
+    }
+
+    range = end;
+  }
+
+  return 0;
+}
+
+#if defined(PLATFORM_LINUX)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define AFFINITY_MAXIMAL_NODES 1024
+#define AFFINITY_MAXIMAL_CPUS 4096
+
+#undef countof
+#define countof(_x) (sizeof((_x)) / sizeof((_x)[0]))
+
+static int affinity_read_file(const char *path, char *buffer, size_t buffer_length);
+
+int affinity_set_cpu(unsigned int cpu) {
+  if (cpu >= CPU_SETSIZE) {
+    return UV_EINVAL;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  if (0 != sched_setaffinity(0, sizeof(set), &set)) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+int affinity_set_memory_node(int node) {
+  unsigned long mask[AFFINITY_MAXIMAL_NODES / (8 * sizeof(unsigned long))] = {0};
+  if (node < 0 || (size_t)node >= 8 * sizeof(mask)) {
+    return UV_EINVAL;
+  }
+
+  mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+
+  // libnuma is not required, the kernel policy is set directly and falls back to other nodes if the node is full
+  if (0 != syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 8 * sizeof(mask) + 1)) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+int affinity_cpu_node(unsigned int cpu) {
+  char buffer[4096] = {0};
+  if (0 != affinity_read_file("/sys/devices/system/node/online", buffer, sizeof(buffer))) {
+    return -1;
+  }
+
+  unsigned int nodes[AFFINITY_MAXIMAL_NODES];
+  size_t nodes_count = 0;
+  if (0 != affinity_parse_list(buffer, nodes, countof(nodes), &nodes_count)) {
+    return -1;
+  }
+
+  size_t node_index = 0;
+  for (node_index = 0; node_index < nodes_count; ++node_index) {
+    unsigned int cpus[AFFINITY_MAXIMAL_CPUS];
+    size_t cpus_count = 0;
+    if (0 != affinity_node_cpus((int)nodes[node_index], cpus, countof(cpus), &cpus_count)) {
+      continue;
+    }
+
+    size_t cpu_index = 0;
+    for (cpu_index = 0; cpu_index < cpus_count; ++cpu_index) {
+      if (cpus[cpu_index] == cpu) {
+        return (int)nodes[node_index];
+      }
+    }
+  }
+
+  return -1;
+}
+
+int affinity_interface_node(const char *name) {
+  assert(NULL != name);
+
+  char path[256] = {0};
+  snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", name);
+
+  // virtual interfaces do not have a device, and devices of single node systems have -1
+  char buffer[64] = {0};
+  if (0 != affinity_read_file(path, buffer, sizeof(buffer))) {
+    return -1;
+  }
+
+  return atoi(buffer);
+}
+
+int affinity_node_cpus(int node, unsigned int *cpus, size_t cpus_max, size_t *cpus_count) {
+  assert(NULL != cpus);
+  assert(NULL != cpus_count);
+
+  char path[256] = {0};
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+  char buffer[4096] = {0};
+  int err = affinity_read_file(path, buffer, sizeof(buffer));
+  if (err) {
+    return err;
+  }
+
+  return affinity_parse_list(buffer, cpus, cpus_max, cpus_count);
+}
+
+int affinity_numa_cpus(int node, unsigned int *cpus, size_t cpus_max, size_t *cpus_count) {
+  assert(NULL != cpus);
+  assert(NULL != cpus_count);
+
+  if (node >= 0) {
+    return affinity_node_cpus(node, cpus, cpus_max, cpus_count);
+  }
+
+  char buffer[4096] = {0};
+  int err = affinity_read_file("/sys/devices/system/node/online", buffer, sizeof(buffer));
+  if (err) {
+    return err;
+  }
+
+  unsigned int nodes[AFFINITY_MAXIMAL_NODES];
+  size_t nodes_count = 0;
+  err = affinity_parse_list(buffer, nodes, countof(nodes), &nodes_count);
+  if (err) {
+    return err;
+  }
+
+  *cpus_count = 0;
+
+  size_t node_index = 0;
+  for (node_index = 0; node_index < nodes_count; ++node_index) {
+    // a node without CPUs or memory may have no cpulist, it is skipped as in affinity_cpu_node
+    size_t node_cpus_count = 0;
+    if (0 != affinity_node_cpus((int)nodes[node_index], cpus + *cpus_count, cpus_max - *cpus_count, &node_cpus_count)) {
+      continue;
+    }
+
+    *cpus_count += node_cpus_count;
+  }
+
+  return 0;
+}
+
+static int affinity_read_file(const char *path, char *buffer, size_t buffer_length) {
+  assert(NULL != path);
+  assert(NULL != buffer);
+  assert(buffer_length > 0);
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  ssize_t length = read(fd, buffer, buffer_length - 1);
+  int err = (length < 0) ? uv_translate_sys_error(errno) : 0;
+  close(fd);
+
+  buffer[(length > 0) ? length : 0] = 0;
+  return err;
+}
+
+#endif /*PLATFORM_LINUX*/
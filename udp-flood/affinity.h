@@ -0,0 +1,24 @@
+#pragma once
+
+#include "./platform.h"
+#include <stddef.h>
+
+// "0-3,8,10-11" format of --cpus and of sysfs lists
+extern int affinity_parse_list(const char *list, unsigned int *items, size_t items_max, size_t *items_count);
+
+#if defined(PLATFORM_LINUX)
+
+// these functions change the calling thread
+extern int affinity_set_cpu(unsigned int cpu);
+extern int affinity_set_memory_node(int node);
+
+// these functions return -1 if the node is unknown
+extern int affinity_cpu_node(unsigned int cpu);
+extern int affinity_interface_node(const char *name);
+
+extern int affinity_node_cpus(int node, unsigned int *cpus, size_t cpus_max, size_t *cpus_count);
+
+// CPUs of the node, or CPUs of all nodes one node after another if the node is negative
+extern int affinity_numa_cpus(int node, unsigned int *cpus, size_t cpus_max, size_t *cpus_count);
+
+#endif /*PLATFORM_LINUX*/
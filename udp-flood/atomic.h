@@ -74,6 +74,8 @@
 #define custom_atomic_init atomic_init
 #define custom_atomic_store atomic_store
 #define custom_atomic_load atomic_load
+#define custom_atomic_store_relaxed(_obj, _desired) atomic_store_explicit((_obj), (_desired), memory_order_relaxed)
+#define custom_atomic_load_relaxed(_obj) atomic_load_explicit((_obj), memory_order_relaxed)
 
 #define custom_atomic_exchange atomic_exchange
 #define custom_atomic_compare_exchange_strong atomic_compare_exchange_strong
@@ -134,6 +136,8 @@
 #define custom_atomic_init std::atomic_init
 #define custom_atomic_store std::atomic_store
 #define custom_atomic_load std::atomic_load
+#define custom_atomic_store_relaxed(_obj, _desired) std::atomic_store_explicit((_obj), (_desired), std::memory_order_relaxed)
+#define custom_atomic_load_relaxed(_obj) std::atomic_load_explicit((_obj), std::memory_order_relaxed)
 
 #define custom_atomic_exchange std::atomic_exchange
 #define custom_atomic_compare_exchange_strong std::atomic_compare_exchange_strong
@@ -210,6 +214,10 @@ typedef volatile uintmax_t custom_atomic_uintmax_t;
 
 #define custom_atomic_load(_obj) (*(_obj))
 
+// aligned volatile accesses of the native width are not torn, they need no interlocked instruction
+#define custom_atomic_store_relaxed(_obj, _desired) ((void)(*(_obj) = (_desired)))
+#define custom_atomic_load_relaxed(_obj) (*(_obj))
+
 #if defined(HAS_ATOMIC_64)
 
 #define custom_atomic_exchange(_obj, _desired)                                                                                 \
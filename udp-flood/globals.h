@@ -1,14 +1,65 @@
 #pragma once
 
+#include "./address.h"
 #include "./atomic.h"
+#include "./profile.h"
+#include "./rate.h"
+#include "./sweep.h"
+#include <stddef.h>
 #include <stdint.h>
 
-extern custom_atomic_size_t g_stats_sent_bytes;
-extern custom_atomic_size_t g_stats_sent_operations;
-
 extern const char *g_arg_address;
 extern bool g_arg_is_ipv4;
+extern bool g_arg_is_numeric;
+extern address_range_t g_arg_address_range;
+extern bool g_arg_is_sweep;
+extern sweep_t g_sweep;
 extern int g_arg_port_min, g_arg_port_max;
 extern int g_arg_size_min, g_arg_size_max;
+extern profile_t g_size_profile;
 extern int g_arg_timeout_ms;
+extern uint64_t g_arg_gap_ns;
+extern uint64_t g_arg_rate_pps, g_arg_rate_bps;
+extern rate_bucket_t g_rate_operations, g_rate_bytes;
 extern int g_arg_workers_count;
+extern unsigned int g_arg_cpus[];
+extern size_t g_arg_cpus_count;
+extern bool g_arg_is_numa;
+extern int g_arg_batch;
+extern int g_arg_gso;
+extern int g_arg_depth;
+extern int g_arg_payload_refresh;
+extern bool g_arg_is_seeded;
+extern uint64_t g_arg_seed;
+extern const char *g_arg_interface;
+extern uint8_t g_arg_destination_mac[6];
+
+typedef enum _engine_e {
+  engine_libuv,
+  engine_io_uring,
+  engine_packet,
+} engine_e;
+
+extern engine_e g_arg_engine;
+extern bool g_arg_is_busy_poll;
+extern bool g_arg_is_sink;
+extern bool g_arg_is_header;
+extern bool g_arg_is_reflect;
+extern bool g_arg_is_rtt;
+
+typedef enum _mtu_discover_e {
+  // the socket keeps the behaviour of the system, IPv4 and IPv6 usually fragment datagrams larger than the path MTU
+  mtu_discover_default,
+  mtu_discover_want,
+  mtu_discover_dont,
+  mtu_discover_do,
+  mtu_discover_probe,
+} mtu_discover_e;
+
+extern mtu_discover_e g_arg_mtu_discover;
+extern bool g_arg_is_zerocopy;
+extern int g_arg_connect;
+extern int g_arg_source_ports;
+extern const char *g_arg_bind;
+extern address_range_t g_arg_bind_range;
+extern int g_arg_sndbuf;
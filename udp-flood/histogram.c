@@ -0,0 +1,145 @@
+#include "./histogram.h"
+#include <assert.h>
+
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif /*COMPILER_MSVC*/
+
+static size_t histogram_bucket_index(uint64_t value);
+
+void histogram_record(histogram_t *histogram, uint64_t value, size_t count) {
+  assert(NULL != histogram);
+
+  // only this thread writes the counts, so a relaxed load and store replace a locked read-modify-write
+  custom_atomic_size_t *bucket = &histogram->counts[histogram_bucket_index(value)];
+  custom_atomic_store_relaxed(bucket, custom_atomic_load_relaxed(bucket) + count);
+
+  // only this thread raises the maximum and the collector only resets it to 0, so it does not have to be compared
+  // and exchanged, a value raced with the reset goes to the next tick at worst
+  size_t maximum = (value < (uint64_t)SIZE_MAX) ? (size_t)value : SIZE_MAX;
+  if (maximum > custom_atomic_load_relaxed(&histogram->maximum)) {
+    custom_atomic_store_relaxed(&histogram->maximum, maximum);
+  }
+}
+
+void histogram_read(histogram_t *histogram, histogram_values_t *total) {
+  assert(NULL != histogram);
+  assert(NULL != total);
+
+  total->count = 0;
+
+  size_t index = 0;
+  for (index = 0; index < HISTOGRAM_BUCKETS; ++index) {
+    total->counts[index] = (uint64_t)custom_atomic_load_relaxed(&histogram->counts[index]);
+    total->count += total->counts[index];
+  }
+
+  total->maximum = (uint64_t)custom_atomic_load(&histogram->maximum);
+}
+
+void histogram_collect(histogram_t *histogram, const histogram_values_t *previous, histogram_values_t *total,
+                       histogram_values_t *tick) {
+  assert(NULL != histogram);
+  assert(NULL != previous);
+  assert(NULL != total);
+  assert(NULL != tick);
+
+  histogram_read(histogram, total);
+
+  tick->count = total->count - previous->count;
+
+  size_t index = 0;
+  for (index = 0; index < HISTOGRAM_BUCKETS; ++index) {
+    tick->counts[index] = total->counts[index] - previous->counts[index];
+  }
+
+  tick->maximum = (uint64_t)custom_atomic_exchange(&histogram->maximum, 0);
+  total->maximum = (previous->maximum > tick->maximum) ? previous->maximum : tick->maximum;
+}
+
+void histogram_add(histogram_values_t *values, const histogram_values_t *other) {
+  assert(NULL != values);
+  assert(NULL != other);
+
+  size_t index = 0;
+  for (index = 0; index < HISTOGRAM_BUCKETS; ++index) {
+    values->counts[index] += other->counts[index];
+  }
+
+  values->count += other->count;
+  if (values->maximum < other->maximum) {
+    values->maximum = other->maximum;
+  }
+}
+
+uint64_t histogram_percentile(const histogram_values_t *values, double percentile) {
+  assert(NULL != values);
+
+  if (0 == values->count) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (double)values->count);
+  if (rank >= values->count) {
+    return values->maximum;
+  }
+
+  uint64_t seen = 0;
+  size_t index = 0;
+  for (index = 0; index < HISTOGRAM_BUCKETS; ++index) {
+    seen += values->counts[index];
+    if (seen > rank) {
+      break;
+    }
+  }
+
+  // the bucket is wider than the values seen in it
+  uint64_t value = histogram_bucket_maximum(index);
+  return (value < values->maximum) ? value : values->maximum;
+}
+
+uint64_t histogram_bucket_maximum(size_t index) {
+  assert(index < HISTOGRAM_BUCKETS);
+
+  if (index + 1 >= HISTOGRAM_BUCKETS) {
+    return UINT64_MAX;
+  }
+
+  // the next bucket starts right after this one
+  size_t group = (index + 1) / HISTOGRAM_SUB_COUNT;
+  uint64_t offset = (uint64_t)((index + 1) % HISTOGRAM_SUB_COUNT);
+  if (0 == group) {
+    return offset - 1;
+  }
+
+  return ((HISTOGRAM_SUB_COUNT + offset) << (group - 1)) - 1;
+}
+
+static size_t histogram_bucket_index(uint64_t value) {
+  if (value < HISTOGRAM_SUB_COUNT) {
+    return (size_t)value;
+  }
+
+  // values of the group have the same highest bit, the next bits select the bucket in the group
+  unsigned int highest = 63;
+#if defined(COMPILER_MSVC)
+  // _BitScanReverse64 is missing on x86
+  unsigned long bit = 0;
+  if (0 != (value >> 32)) {
+    _BitScanReverse(&bit, (unsigned long)(value >> 32));
+    bit += 32;
+  } else {
+    _BitScanReverse(&bit, (unsigned long)value);
+  }
+  highest = (unsigned int)bit;
+#else
+  highest = 63 - (unsigned int)__builtin_clzll(value);
+#endif /*COMPILER_MSVC*/
+
+  size_t group = highest - HISTOGRAM_SUB_BITS + 1;
+  if (group >= HISTOGRAM_BUCKETS / HISTOGRAM_SUB_COUNT) {
+    return HISTOGRAM_BUCKETS - 1;
+  }
+
+  return group * HISTOGRAM_SUB_COUNT + (size_t)(value >> (group - 1)) - HISTOGRAM_SUB_COUNT;
+}
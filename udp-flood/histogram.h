@@ -0,0 +1,41 @@
+#pragma once
+
+#include "./atomic.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// values below HISTOGRAM_SUB_COUNT have own buckets, every next power of two is split into HISTOGRAM_SUB_COUNT buckets,
+// so a bucket is at most 1/HISTOGRAM_SUB_COUNT of its value wide
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+// values up to 2^40 ns (18 minutes) are distinguished, larger ones are put to the last bucket
+#define HISTOGRAM_MAXIMAL_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAXIMAL_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+// only one thread records values, another thread reads them
+typedef struct _histogram_t {
+  custom_atomic_size_t counts[HISTOGRAM_BUCKETS];
+  // only the recording thread raises the maximum, histogram_collect takes it and resets it to 0 at each tick
+  custom_atomic_size_t maximum;
+} histogram_t;
+
+typedef struct _histogram_values_t {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  uint64_t maximum;
+} histogram_values_t;
+
+extern void histogram_record(histogram_t *histogram, uint64_t value, size_t count);
+
+// reads the counts without changing the histogram, the maximum is the one of the current tick
+extern void histogram_read(histogram_t *histogram, histogram_values_t *total);
+
+// total gets all recorded values and tick gets the values recorded since the previous total
+extern void histogram_collect(histogram_t *histogram, const histogram_values_t *previous, histogram_values_t *total,
+                              histogram_values_t *tick);
+extern void histogram_add(histogram_values_t *values, const histogram_values_t *other);
+
+// the highest value of the bucket that contains the percentile, the maximum is exact
+extern uint64_t histogram_percentile(const histogram_values_t *values, double percentile);
+
+extern uint64_t histogram_bucket_maximum(size_t index);
@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 int g_logger_level = LOGGER_LEVEL_INFO;
+bool g_logger_is_stderr = false;
 
 void logger_print_error(const char *format, ...) {
   assert(NULL != format);
@@ -17,7 +18,7 @@ void logger_print_error(const char *format, ...) {
   va_list args;
   va_start(args, format);
 
-  vprintf_s(format, args);
+  vfprintf_s(g_logger_is_stderr ? stderr : stdout, format, args);
 
   va_end(args);
 }
@@ -32,7 +33,7 @@ void logger_print_info(const char *format, ...) {
   va_list args;
   va_start(args, format);
 
-  vprintf_s(format, args);
+  vfprintf_s(g_logger_is_stderr ? stderr : stdout, format, args);
 
   va_end(args);
 }
@@ -47,7 +48,7 @@ void logger_print_trace(const char *format, ...) {
   va_list args;
   va_start(args, format);
 
-  vprintf_s(format, args);
+  vfprintf_s(g_logger_is_stderr ? stderr : stdout, format, args);
 
   va_end(args);
 }
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <stdbool.h>
+
 #define LOGGER_LEVEL_ERROR 1
 #define LOGGER_LEVEL_INFO 2
 #define LOGGER_LEVEL_TRACE 3
 
 extern int g_logger_level;
 
+// messages go to stderr instead of stdout, so they do not mix with json or csv records on stdout
+extern bool g_logger_is_stderr;
+
 extern void logger_print_error(const char *format, ...);
 extern void logger_print_info(const char *format, ...);
 extern void logger_print_trace(const char *format, ...);
@@ -1,10 +1,17 @@
 #include "./globals.h"
+#include "./affinity.h"
 #include "./logger.h"
 #include "./loop.h"
+#include "./metrics.h"
+#include "./pacer.h"
 #include "./platform.h"
+#include "./probe.h"
+#include "./report.h"
+#include "./stats.h"
 #include "./worker.h"
 #include <assert.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,32 +25,97 @@
 #define DEFAULT_SIZE 4096
 #define DEFAULT_TIMEOUT 0
 #define DEFAULT_WORKERS 1
+#define DEFAULT_BATCH 1
+#define DEFAULT_GSO 1
+#define DEFAULT_DEPTH 1
+#define DEFAULT_PAYLOAD_REFRESH 0
+#define DEFAULT_STATS_INTERVAL 1000
+#define DEFAULT_DESTINATION_MAC "ff:ff:ff:ff:ff:ff"
+#define DEFAULT_SOURCE_PORTS 1
 
 #define MINIMAL_PORT 1
 #define MAXIMAL_PORT 65535
 #define MINIMAL_SIZE 1
-#define MAXIMAL_SIZE 4096
+// UDP payload of the largest IP datagram, the 65535 bytes of IPv4 include its header and the ones of IPv6 do not
+#define MAXIMAL_SIZE_IPV4 65507
+#define MAXIMAL_SIZE 65527
 #define MINIMAL_TIMEOUT 0
 #define MAXIMAL_TIMEOUT 60 * 60 * 1000
 #define MINIMAL_WORKERS 1
 #define MAXIMAL_WORKERS 1024
+#define MAXIMAL_CPUS 4096
+#define MINIMAL_BATCH 1
+#define MAXIMAL_BATCH 1024
+#define MINIMAL_GSO 1
+#define MAXIMAL_GSO 64
+#define MAXIMAL_GSO_BYTES 65507
+#define MINIMAL_DEPTH 1
+#define MAXIMAL_DEPTH 1024
+#define MINIMAL_PAYLOAD_REFRESH 0
+#define MAXIMAL_PAYLOAD_REFRESH 100
+#define MINIMAL_GAP_NS 100
+#define MAXIMAL_GAP_NS (60 * 1000 * 1000 * 1000ull)
+#define MINIMAL_RATE 1
+#define MAXIMAL_RATE_PPS 1000000000000ull
+#define MAXIMAL_RATE_BPS 100000000000000ull
+#define MINIMAL_CONNECT 0
+#define MAXIMAL_CONNECT 64
+#define MINIMAL_SOURCE_PORTS 1
+#define MAXIMAL_SOURCE_PORTS 256
+#define MINIMAL_SNDBUF 0
+#define MAXIMAL_SNDBUF (1024 * 1024 * 1024)
+#define MINIMAL_STATS_INTERVAL 10
+#define MAXIMAL_STATS_INTERVAL (60 * 60 * 1000)
 
 #undef countof
 #define countof(_x) (sizeof((_x)) / sizeof((_x)[0]))
 
-custom_atomic_size_t g_stats_sent_bytes = 0;
-custom_atomic_size_t g_stats_sent_operations = 0;
 static bool s_stats_raw = false;
+static report_format_e s_stats_format = report_format_text;
+static const char *s_stats_file = NULL;
+static int s_stats_interval_ms = DEFAULT_STATS_INTERVAL;
+static const char *s_metrics_address = NULL;
+static const char *s_size_profile = NULL;
 static uint64_t s_stats_start_ns = 0, s_stats_prev_ns = 0;
-static uint64_t s_stats_prev_sent_bytes = 0;
-static uint64_t s_stats_prev_sent_operations = 0;
 
 const char *g_arg_address = DEFAULT_ADDRESS;
 bool g_arg_is_ipv4 = true;
+bool g_arg_is_numeric = true;
+address_range_t g_arg_address_range;
+bool g_arg_is_sweep = false;
+sweep_t g_sweep;
 int g_arg_port_min = DEFAULT_PORT, g_arg_port_max = DEFAULT_PORT;
 int g_arg_size_min = DEFAULT_SIZE, g_arg_size_max = DEFAULT_SIZE;
+profile_t g_size_profile;
 int g_arg_timeout_ms = DEFAULT_TIMEOUT;
+uint64_t g_arg_gap_ns = 0;
+uint64_t g_arg_rate_pps = 0, g_arg_rate_bps = 0;
+rate_bucket_t g_rate_operations, g_rate_bytes;
 int g_arg_workers_count = DEFAULT_WORKERS;
+unsigned int g_arg_cpus[MAXIMAL_CPUS];
+size_t g_arg_cpus_count = 0;
+bool g_arg_is_numa = false;
+int g_arg_batch = DEFAULT_BATCH;
+int g_arg_gso = DEFAULT_GSO;
+int g_arg_depth = DEFAULT_DEPTH;
+int g_arg_payload_refresh = DEFAULT_PAYLOAD_REFRESH;
+bool g_arg_is_seeded = false;
+uint64_t g_arg_seed = 0;
+const char *g_arg_interface = NULL;
+uint8_t g_arg_destination_mac[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+engine_e g_arg_engine = engine_libuv;
+bool g_arg_is_busy_poll = false;
+bool g_arg_is_sink = false;
+bool g_arg_is_header = false;
+bool g_arg_is_reflect = false;
+bool g_arg_is_rtt = false;
+mtu_discover_e g_arg_mtu_discover = mtu_discover_default;
+bool g_arg_is_zerocopy = false;
+int g_arg_connect = 0;
+int g_arg_source_ports = DEFAULT_SOURCE_PORTS;
+const char *g_arg_bind = NULL;
+address_range_t g_arg_bind_range;
+int g_arg_sndbuf = 0;
 
 typedef enum _parse_result_e {
   parse_result_exit,
@@ -53,16 +125,18 @@ typedef enum _parse_result_e {
 } parse_result_e;
 
 static parse_result_e parse_args(int argc, char **argv);
+static bool parse_int(const char *arg, int *value);
+static bool parse_rate(const char *arg, uint64_t *rate);
+static bool parse_size_profile(const char *arg);
 
 static void show_help(void);
 static void show_version(void);
 
 static void sigint_handler(uv_signal_t *sigint, int signum);
 static void stats_handler(uv_timer_t *timer);
+static void stats_dump(void);
 static void closed_handler(uv_handle_t *handle);
 
-static unsigned int random(void);
-
 int main(int argc, char **argv) {
   (void)argc;
   (void)argv;
@@ -125,7 +199,7 @@ int main(int argc, char **argv) {
   }
 
   s_stats_start_ns = s_stats_prev_ns = uv_hrtime();
-  err = uv_timer_start(&stats_timer, stats_handler, 1 * 1000, 1 * 1000);
+  err = uv_timer_start(&stats_timer, stats_handler, s_stats_interval_ms, s_stats_interval_ms);
   if (err) {
     logger_print_error("uv_timer_start failed: %s\n", uv_strerror(err));
     uv_close((uv_handle_t *)&stats_timer, closed_handler);
@@ -143,6 +217,43 @@ int main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
+  if (!stats_init(g_arg_workers_count)) {
+    logger_print_error("calloc failed: %s\n", uv_strerror(UV_ENOMEM));
+    free(workers);
+    uv_close((uv_handle_t *)&stats_timer, closed_handler);
+    uv_close((uv_handle_t *)&sigint, closed_handler);
+    loop_term(&loop, 0);
+    return EXIT_FAILURE;
+  }
+
+  err = report_open(s_stats_format, s_stats_file);
+  if (err) {
+    logger_print_error("fopen(%s) failed: %s\n", s_stats_file, uv_strerror(err));
+    stats_term();
+    free(workers);
+    uv_close((uv_handle_t *)&stats_timer, closed_handler);
+    uv_close((uv_handle_t *)&sigint, closed_handler);
+    loop_term(&loop, 0);
+    return EXIT_FAILURE;
+  }
+
+  // the listener runs on the main loop and only loads the counters of workers
+  if (NULL != s_metrics_address) {
+    err = metrics_start(&loop, s_metrics_address);
+    if (err) {
+      logger_print_error("Metrics listener on %s failed: %s\n", s_metrics_address, uv_strerror(err));
+      report_close();
+      stats_term();
+      free(workers);
+      uv_close((uv_handle_t *)&stats_timer, closed_handler);
+      uv_close((uv_handle_t *)&sigint, closed_handler);
+      loop_term(&loop, 0);
+      return EXIT_FAILURE;
+    }
+
+    logger_print_info("Serving metrics on %s\n", s_metrics_address);
+  }
+
 #if defined(PLATFORM_WINDOWS)
   DWORD_PTR process_affinity = 0;
   DWORD_PTR system_affinity = 0;
@@ -154,22 +265,33 @@ int main(int argc, char **argv) {
   }
 #endif /*PLATFORM_WINDOWS*/
 
+  // the credits are earned from now, all workers share them
+  uint64_t rate_start_ns = uv_hrtime();
+  rate_bucket_init(&g_rate_operations, g_arg_rate_pps, rate_start_ns);
+  // the byte rate is rounded up, so a rate below 8 bits per second still limits instead of turning into 0 (unlimited)
+  rate_bucket_init(&g_rate_bytes, (g_arg_rate_bps + 7) / 8, rate_start_ns);
+
   logger_print_info("Starting %d workers...\n", g_arg_workers_count);
 
   int worker_index = 0;
   for (worker_index = 0; worker_index < g_arg_workers_count; ++worker_index) {
-    if (0 == worker_index) {
+    // busy-poll workers never return to a loop, so the main loop keeps only stats
+    if (0 == worker_index && !g_arg_is_busy_poll) {
       workers[worker_index] = worker_create_in_loop(&loop, worker_index + 1);
     } else {
       workers[worker_index] = worker_create_in_thread(worker_index + 1);
     }
 
     if (NULL == workers[worker_index]) {
-      for (; worker_index >= 0; --worker_index) {
+      // the failed worker is already released, only the started ones should be stopped
+      for (--worker_index; worker_index >= 0; --worker_index) {
         worker_destroy(workers[worker_index]);
       }
 
       free(workers);
+      metrics_stop();
+      report_close();
+      stats_term();
       uv_close((uv_handle_t *)&stats_timer, closed_handler);
       uv_close((uv_handle_t *)&sigint, closed_handler);
       loop_term(&loop, 0);
@@ -181,6 +303,7 @@ int main(int argc, char **argv) {
 
   loop_run(&loop);
 
+  metrics_stop();
   uv_close((uv_handle_t *)&stats_timer, closed_handler);
   uv_close((uv_handle_t *)&sigint, closed_handler);
 
@@ -192,7 +315,11 @@ int main(int argc, char **argv) {
 
   loop_term(&loop, 0);
 
+  stats_dump();
+
   free(workers);
+  report_close();
+  stats_term();
 
   return EXIT_SUCCESS;
 }
@@ -213,41 +340,143 @@ static void show_help(void) {
   printf("        --raw-stats    Do not convert stats to minutes and Gbytes\n");
   printf("\n");
 
+  printf("Stats options:\n");
+  printf("        --stats-format <name>  Format of stats, text, json (one object per line) or csv\n");
+  printf("        --stats-file <path>    File of json or csv stats instead of stdout\n");
+  printf("        --stats-interval <ms>  Interval between stats\n");
+  printf("        --metrics <address>    Serve Prometheus metrics on [host:]port or unix:<path>\n");
+  printf("\n");
+
   printf("Flood options:\n");
-  printf("    -a, --address <address>    Destination IP address\n");
-  printf("    -p, --port <port>          Destination port\n");
+  printf("    -a, --address <address>    Destination IP address, mask or CIDR range\n");
+  printf("    -p, --port <port>          Destination port or range (min-max)\n");
   printf("        --port-min <port>      Minimal destination port\n");
   printf("        --port-max <port>      Maximal destination port\n");
+  printf("        --sweep                Visit every address and port once per pass in pseudo-random order\n");
   printf("    -s, --size <bytes>         Size of one datagram\n");
   printf("        --size-min <bytes>     Minimal size of one datagram\n");
   printf("        --size-max <bytes>     Maximal size of one datagram\n");
+  printf("        --size-profile <name>  Weighted sizes, imix or file:<path>\n");
+  printf("        --payload-refresh <%%>  Part of each datagram size generated again in the payload pool\n");
+  printf("        --seed <number>        Seed of the random generator for reproducible runs\n");
+  printf("        --header               Start each datagram with a sequence number and a send time\n");
+  printf("        --rtt                  Receive replies of a reflector and measure round trip times, implies --header\n");
   printf("    -t, --timeout <ms>         Intervals between sendings for each worker\n");
+  printf("        --gap <us>             Precise intervals between sends of each worker, fractions are allowed\n");
+  printf("        --rate-pps <count>     Datagrams per second of all workers together\n");
+  printf("        --rate-bps <bits>      Payload bits per second of all workers together\n");
   printf("    -w, --workers <count>      Workers count\n");
+  printf("        --cpus <list>          CPUs of workers, for example 0-3,8 (Linux only)\n");
+  printf("        --numa                 Allocate memory of each worker on the node of its CPU (Linux only)\n");
+  printf("    -b, --batch <count>        Datagrams sent by one system call (Linux only)\n");
+  printf("        --gso <count>          Datagrams of the same destination split by the kernel (Linux only)\n");
+  printf("    -d, --depth <count>        Sends in flight for each worker\n");
+  printf("    -e, --engine <name>        Send engine, libuv, io_uring or packet (Linux only)\n");
+  printf("        --busy-poll            Send from a tight loop on a non-blocking socket without libuv (Linux only)\n");
+  printf("        --sink                 Receive on the address and port instead of sending (Linux only)\n");
+  printf("        --reflect              Send received datagrams back to their sources, implies --sink (Linux only)\n");
+  printf("        --mtu-discover <mode>  Path MTU discovery and DF bit, want, dont, do or probe (Linux only)\n");
+  printf("        --zerocopy             Send payloads with MSG_ZEROCOPY instead of copying them (Linux only)\n");
+  printf("        --connect <count>      Sockets of each worker connected to the latest destinations\n");
+  printf("        --source-ports <count> Sockets of each worker, every one has its own source port\n");
+  printf("        --bind <address>       Source address, mask or CIDR range of the sockets\n");
+  printf("        --sndbuf <bytes>       Send buffer size of each socket (SO_SNDBUF)\n");
+  printf("    -i, --interface <name>     Network interface of the packet engine\n");
+  printf("        --dst-mac <mac>        Destination MAC address of the packet engine\n");
   printf("\n");
 
   printf("Notes:\n");
   printf("  * Destination address could have '*' symbols, in this case a random number will be used in this position\n");
+  printf("  * Destination address could be a CIDR range (10.0.0.0/12, 2001:db8::/48), random host bits will be used\n");
   printf("  * Destination address could be IPv4 (with dots) or IPv6 (with colons)\n");
+  printf("  * Destination host name is resolved for each datagram, numeric address is used without resolving\n");
   printf("  * `--port-min` and `--port-max` could be used to randomize the destination port\n");
+  printf("  * `--sweep` splits the address and port space between workers and repeats it after each pass, at most one worker for each destination\n");
   printf("  * `--size-min` and `--size-max` could be used to randomize the datagram size\n");
+  printf("  * `--size-profile` replaces the size range, every size is drawn with its weight in constant time (alias method)\n");
+  printf("  * `imix` is 7:4:1 of 64, 594 and 1518 byte frames (18, 548 and 1472 bytes of IPv4 payload)\n");
+  printf("  * A profile file has lines of a size and a weight, `#` starts a comment, at most %d sizes\n", PROFILE_MAXIMAL_ENTRIES);
+  printf("  * Stats show the mean size of a profile, the sizes and their shares are shown at exit\n");
   printf("  * Application sends random data, do not use a port if someone is listening to it\n");
+  printf("  * Each worker generates random data once, datagrams are slices of it at random offsets\n");
+  printf("  * With `--seed` every worker draws its data, ports, addresses and sizes from its own reproducible stream\n");
+  printf("  * `--gap` keeps an ideal schedule of sends, it sleeps on a timerfd and spins for the last %d us\n", PACER_SPIN_NS / 1000);
+  printf("  * `--rate-pps` and `--rate-bps` accept K, M and G suffixes (1.2M), stats show the achieved part of the rate\n");
   printf("  * `--workers` can be 0, in this case one worker will be created for each CPU\n");
+  printf("  * `--cpus` pins one worker to each CPU of the list and starts again from the first CPU if there are more workers\n");
+  printf("  * `--numa` without `--cpus` pins workers to CPUs of the node of `--interface`, or fills one node after another\n");
+  printf("  * `--verbose` also shows stats of each worker\n");
+  printf("  * Stats show latency from the time a send is due to its submission and to its completion, histograms at exit\n");
+  printf("  * json stats have one object per interval, csv stats have a row of each worker and a row of all workers (worker 0)\n");
+  printf("  * json and csv stats are written to stdout instead of text stats if there is no `--stats-file`, messages go to stderr\n");
+  printf("  * Stats rates are per second for any `--stats-interval`, errors are failed sends of the interval\n");
+  printf("  * `--metrics` listens on 127.0.0.1 if the host is omitted, any GET request gets the metrics over HTTP\n");
+  printf("  * `--batch` prepares datagrams in advance and sends them with one `sendmmsg`, `--timeout` is applied between batches\n");
+  printf("  * `--gso` uses UDP generic segmentation offload, it requires a fixed size and falls back if the kernel refuses it\n");
+  printf("  * `--depth` keeps several sends of the libuv engine in flight, stats show how many of them are in flight\n");
+  printf("  * `--engine io_uring` keeps `--batch` sends in flight for each worker, buffers are built once\n");
+  printf("  * `--engine packet` writes whole frames to an AF_PACKET ring of `--interface`, it requires root or CAP_NET_RAW\n");
+  printf("  * `--busy-poll` runs every worker in its own thread and keeps its CPU busy, `--batch` uses `sendmmsg`, dropped datagrams are failures\n");
+  printf("  * `--sink` binds every worker to the same port with SO_REUSEPORT and drains it with `recvmmsg` of `--batch`\n");
+  printf("  * Stats of `--sink` count received datagrams and bytes, failures are failed receives, `--metrics` names them `received`\n");
+  printf("  * `--header` writes %d bytes of magic, worker, sequence of the socket and send time in front of the payload\n", PROBE_HEADER_SIZE);
+  printf("  * `--sink` tracks up to %d flows of headers (sender address and worker) for loss, reordering and duplicates\n", PROBE_FLOWS_CAPACITY);
+  printf("  * One-way latency of headers uses the monotonic clock, so the sender and `--sink` should run on one host\n");
+  printf("  * `--reflect` sends back at most %d bytes of each datagram, replies which do not fit the socket buffer are failures\n", WORKER_SINK_BUFFER_SIZE);
+  printf("  * `--rtt` reads replies on the sockets of the workers, the round trip uses only the clock of the sender\n");
+  printf("  * Datagrams larger than the MTU are fragmented, stats count the fragments for the MTU of the route to the address\n");
+  printf("  * `--mtu-discover dont` fragments datagrams and never sets DF, `do` sets DF and refuses datagrams larger than the path MTU\n");
+  printf("  * `--mtu-discover probe` sets DF and ignores the path MTU, `want` fragments only datagrams larger than the path MTU\n");
+  printf("  * `--zerocopy` pins the payload pool instead of copying it, it pays off for datagrams of about 10 KB and more\n");
+  printf("  * `--connect` sends without an address on a connected socket, so the kernel does not look up the route each time\n");
+  printf("  * The least recently used connected socket gets a new destination, stats show how often sockets are connected\n");
+  printf("  * Connected sockets get ICMP errors of their destinations, so sends to a closed port fail with connection refused\n");
+  printf("  * `--source-ports` spreads datagrams over source ports, so a receiver with RSS puts them into several queues\n");
+  printf("  * Sockets are rotated for every datagram of the libuv and io_uring engines and for every batch of `sendmmsg`\n");
+  printf("  * `--bind` binds the sockets of all workers to consecutive addresses of the range, the kernel picks the ports\n");
+  printf("  * `--sndbuf` is doubled by Linux and limited by net.core.wmem_max unless the process has CAP_NET_ADMIN\n");
+  printf("  * `--dst-mac` should be the MAC address of the next hop, the packet engine does not resolve it\n");
   printf("  * A worker stops on the first error\n");
   printf("\n");
 
   printf("Defaults:\n");
-  printf("    --address    %s\n", DEFAULT_ADDRESS);
-  printf("    --port       %d\n", DEFAULT_PORT);
-  printf("    --size       %d\n", DEFAULT_SIZE);
-  printf("    --timeout    %d\n", DEFAULT_TIMEOUT);
-  printf("    --workers    %d\n", DEFAULT_WORKERS);
+  printf("    --address           %s\n", DEFAULT_ADDRESS);
+  printf("    --port              %d\n", DEFAULT_PORT);
+  printf("    --size              %d\n", DEFAULT_SIZE);
+  printf("    --timeout           %d\n", DEFAULT_TIMEOUT);
+  printf("    --gap               0 (disabled)\n");
+  printf("    --rate-pps          0 (unlimited)\n");
+  printf("    --rate-bps          0 (unlimited)\n");
+  printf("    --workers           %d\n", DEFAULT_WORKERS);
+  printf("    --batch             %d\n", DEFAULT_BATCH);
+  printf("    --gso               %d\n", DEFAULT_GSO);
+  printf("    --depth             %d\n", DEFAULT_DEPTH);
+  printf("    --payload-refresh   %d\n", DEFAULT_PAYLOAD_REFRESH);
+  printf("    --engine            libuv\n");
+  printf("    --dst-mac           %s\n", DEFAULT_DESTINATION_MAC);
+  printf("    --connect           0 (disabled)\n");
+  printf("    --source-ports      %d\n", DEFAULT_SOURCE_PORTS);
+  printf("    --sndbuf            0 (system default)\n");
+  printf("    --stats-format      text\n");
+  printf("    --stats-interval    %d\n", DEFAULT_STATS_INTERVAL);
   printf("\n");
 
   printf("Limits:\n");
-  printf("    --port       %d <= port <= %d\n", MINIMAL_PORT, MAXIMAL_PORT);
-  printf("    --size       %d <= size <= %d\n", MINIMAL_SIZE, MAXIMAL_SIZE);
-  printf("    --timeout    %d <= timeout <= %d\n", MINIMAL_TIMEOUT, MAXIMAL_TIMEOUT);
-  printf("    --workers    %d <= workers <= %d\n", MINIMAL_WORKERS, MAXIMAL_WORKERS);
+  printf("    --port              %d <= port <= %d\n", MINIMAL_PORT, MAXIMAL_PORT);
+  printf("    --size              %d <= size <= %d (IPv4), %d (IPv6)\n", MINIMAL_SIZE, MAXIMAL_SIZE_IPV4, MAXIMAL_SIZE);
+  printf("    --timeout           %d <= timeout <= %d\n", MINIMAL_TIMEOUT, MAXIMAL_TIMEOUT);
+  printf("    --workers           %d <= workers <= %d\n", MINIMAL_WORKERS, MAXIMAL_WORKERS);
+  printf("    --batch             %d <= batch <= %d\n", MINIMAL_BATCH, MAXIMAL_BATCH);
+  printf("    --gso               %d <= gso <= %d, size * gso <= %d\n", MINIMAL_GSO, MAXIMAL_GSO, MAXIMAL_GSO_BYTES);
+  printf("    --depth             %d <= depth <= %d\n", MINIMAL_DEPTH, MAXIMAL_DEPTH);
+  printf("    --payload-refresh   %d <= percent <= %d\n", MINIMAL_PAYLOAD_REFRESH, MAXIMAL_PAYLOAD_REFRESH);
+  printf("    --gap               %.1f <= gap <= %" PRIu64 "\n", MINIMAL_GAP_NS / 1000.0, (uint64_t)(MAXIMAL_GAP_NS / 1000));
+  printf("    --rate-pps          %d <= count <= %" PRIu64 "\n", MINIMAL_RATE, (uint64_t)MAXIMAL_RATE_PPS);
+  printf("    --rate-bps          %d <= bits <= %" PRIu64 "\n", MINIMAL_RATE, (uint64_t)MAXIMAL_RATE_BPS);
+  printf("    --connect           %d <= count <= %d\n", MINIMAL_CONNECT, MAXIMAL_CONNECT);
+  printf("    --source-ports      %d <= count <= %d\n", MINIMAL_SOURCE_PORTS, MAXIMAL_SOURCE_PORTS);
+  printf("    --sndbuf            %d <= bytes <= %d\n", MINIMAL_SNDBUF, MAXIMAL_SNDBUF);
+  printf("    --stats-interval    %d <= interval <= %d\n", MINIMAL_STATS_INTERVAL, MAXIMAL_STATS_INTERVAL);
 
   // clang-format on
 }
@@ -256,12 +485,126 @@ static void show_version(void) {
   printf("Version %s, (c) %s %s\n", VERSION, YEARS, AUTHOR);
 }
 
+static bool parse_int(const char *arg, int *value) {
+  assert(NULL != arg);
+  assert(NULL != value);
+
+  char *end = NULL;
+  long number = strtol(arg, &end, 10);
+  if (end == arg || 0 != *end || number < INT_MIN || number > INT_MAX) {
+    return false;
+  }
+
+  *value = (int)number;
+  return true;
+}
+
+static bool parse_rate(const char *arg, uint64_t *rate) {
+  assert(NULL != arg);
+  assert(NULL != rate);
+
+  char *end = NULL;
+  double value = strtod(arg, &end);
+  if (end == arg || value < 0) {
+    return false;
+  }
+
+  if ('k' == *end || 'K' == *end) {
+    value *= 1.0E3;
+    ++end;
+  } else if ('m' == *end || 'M' == *end) {
+    value *= 1.0E6;
+    ++end;
+  } else if ('g' == *end || 'G' == *end) {
+    value *= 1.0E9;
+    ++end;
+  }
+
+  if (0 != *end || value >= 1.0E18) {
+    return false;
+  }
+
+  *rate = (uint64_t)(value + 0.5);
+  return true;
+}
+
+static bool parse_size_profile(const char *arg) {
+  assert(NULL != arg);
+
+  profile_init(&g_size_profile);
+
+  int err = 0;
+  if (0 == strcmp(arg, "imix")) {
+    // the header should fit the smallest datagram
+    err = profile_add_imix(&g_size_profile, g_arg_is_header ? PROBE_HEADER_SIZE : MINIMAL_SIZE);
+  } else if (0 == strncmp(arg, "file:", 5)) {
+    unsigned int line = 0;
+    err = profile_load(&g_size_profile, arg + 5, &line);
+    if (err && 0 != line) {
+      printf("Invalid size profile %s at line %u\n", arg + 5, line);
+      return false;
+    } else if (err) {
+      printf("Cannot read size profile %s: %s\n", arg + 5, uv_strerror(err));
+      return false;
+    }
+  } else {
+    printf("Unknown size profile %s\n", arg);
+    return false;
+  }
+
+  if (!err) {
+    err = profile_build(&g_size_profile);
+  }
+
+  if (err) {
+    printf("Invalid size profile %s, it requires at most %d sizes with positive total weight\n", arg,
+           PROFILE_MAXIMAL_ENTRIES);
+    profile_init(&g_size_profile);
+    return false;
+  }
+
+  g_arg_size_min = g_size_profile.size_min;
+  g_arg_size_max = g_size_profile.size_max;
+
+  logger_print_trace("Size profile %s has %u sizes of %d-%d bytes, mean %.1f bytes\n", arg, g_size_profile.count,
+                     g_arg_size_min, g_arg_size_max, g_size_profile.mean);
+
+  return true;
+}
+
 static parse_result_e parse_args(int argc, char **argv) {
   g_arg_address = DEFAULT_ADDRESS;
   g_arg_port_min = g_arg_port_max = DEFAULT_PORT;
   g_arg_size_min = g_arg_size_max = DEFAULT_SIZE;
+  s_size_profile = NULL;
+  profile_init(&g_size_profile);
   g_arg_timeout_ms = DEFAULT_TIMEOUT;
+  g_arg_gap_ns = 0;
+  g_arg_rate_pps = g_arg_rate_bps = 0;
   g_arg_workers_count = DEFAULT_WORKERS;
+  g_arg_cpus_count = 0;
+  g_arg_is_numa = false;
+  g_arg_batch = DEFAULT_BATCH;
+  g_arg_gso = DEFAULT_GSO;
+  g_arg_depth = DEFAULT_DEPTH;
+  g_arg_payload_refresh = DEFAULT_PAYLOAD_REFRESH;
+  g_arg_is_seeded = false;
+  g_arg_seed = 0;
+  g_arg_engine = engine_libuv;
+  g_arg_is_busy_poll = false;
+  g_arg_is_sink = false;
+  g_arg_is_header = false;
+  g_arg_is_reflect = false;
+  g_arg_is_rtt = false;
+  g_arg_mtu_discover = mtu_discover_default;
+  g_arg_is_zerocopy = false;
+  g_arg_connect = 0;
+  g_arg_source_ports = DEFAULT_SOURCE_PORTS;
+  g_arg_bind = NULL;
+  g_arg_sndbuf = 0;
+  g_arg_interface = NULL;
+  memset(g_arg_destination_mac, 0xff, sizeof(g_arg_destination_mac));
+  g_arg_is_sweep = false;
 
   int argi = 0;
   for (argi = 1; argi < argc; ++argi) {
@@ -284,6 +627,52 @@ static parse_result_e parse_args(int argc, char **argv) {
       s_stats_raw = true;
     }
 
+    else if (0 == strcmp(arg, "--stats-format")) {
+      if (!has_next) {
+        printf("Required stats format\n");
+        return parse_result_exit;
+      } else if (0 == strcmp(next_arg, "text")) {
+        s_stats_format = report_format_text;
+      } else if (0 == strcmp(next_arg, "json")) {
+        s_stats_format = report_format_json;
+      } else if (0 == strcmp(next_arg, "csv")) {
+        s_stats_format = report_format_csv;
+      } else {
+        printf("Unknown stats format %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--stats-file")) {
+      if (!has_next) {
+        printf("Required stats file\n");
+        return parse_result_exit;
+      } else {
+        s_stats_file = next_arg;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--metrics")) {
+      if (!has_next) {
+        printf("Required metrics address\n");
+        return parse_result_exit;
+      } else {
+        s_metrics_address = next_arg;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--stats-interval")) {
+      if (!has_next) {
+        printf("Required stats interval\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &s_stats_interval_ms)) {
+        printf("Invalid stats interval %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
     else if (0 == strcmp(arg, "-a") || 0 == strcmp(arg, "--address")) {
       if (!has_next) {
         printf("Required address\n");
@@ -299,17 +688,36 @@ static parse_result_e parse_args(int argc, char **argv) {
       if (!has_next) {
         printf("Required port\n");
         return parse_result_exit;
-      } else {
-        g_arg_port_min = g_arg_port_max = atoi(next_arg);
       }
 
+      // a single port or a range of two ports, nothing may follow the numbers
+      const char *text = next_arg;
+      char *end = NULL;
+      long port_min = strtol(text, &end, 10);
+      long port_max = port_min;
+      bool is_valid = end != text;
+      if (is_valid && '-' == *end) {
+        text = end + 1;
+        port_max = strtol(text, &end, 10);
+        is_valid = end != text;
+      }
+
+      if (!is_valid || 0 != *end || port_min < INT_MIN || port_min > INT_MAX || port_max < INT_MIN || port_max > INT_MAX) {
+        printf("Invalid port %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      g_arg_port_min = (int)port_min;
+      g_arg_port_max = (int)port_max;
+
       ++argi;
     } else if (0 == strcmp(arg, "--port-min")) {
       if (!has_next) {
         printf("Required minimal port\n");
         return parse_result_exit;
-      } else {
-        g_arg_port_min = atoi(next_arg);
+      } else if (!parse_int(next_arg, &g_arg_port_min)) {
+        printf("Invalid minimal port %s\n", next_arg);
+        return parse_result_exit;
       }
 
       ++argi;
@@ -317,13 +725,18 @@ static parse_result_e parse_args(int argc, char **argv) {
       if (!has_next) {
         printf("Required maximal port\n");
         return parse_result_exit;
-      } else {
-        g_arg_port_max = atoi(next_arg);
+      } else if (!parse_int(next_arg, &g_arg_port_max)) {
+        printf("Invalid maximal port %s\n", next_arg);
+        return parse_result_exit;
       }
 
       ++argi;
     }
 
+    else if (0 == strcmp(arg, "--sweep")) {
+      g_arg_is_sweep = true;
+    }
+
     else if (0 == strcmp(arg, "-s") || 0 == strcmp(arg, "--size")) {
       if (!has_next) {
         printf("Required size\n");
@@ -350,6 +763,44 @@ static parse_result_e parse_args(int argc, char **argv) {
         g_arg_size_max = atoi(next_arg);
       }
 
+      ++argi;
+    } else if (0 == strcmp(arg, "--size-profile")) {
+      if (!has_next) {
+        printf("Required size profile\n");
+        return parse_result_exit;
+      } else {
+        s_size_profile = next_arg;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--gap")) {
+      if (!has_next) {
+        printf("Required gap\n");
+        return parse_result_exit;
+      }
+
+      char *end = NULL;
+      double gap_us = strtod(next_arg, &end);
+      if (end == next_arg || 0 != *end || !(gap_us * 1000.0 >= MINIMAL_GAP_NS && gap_us * 1000.0 <= MAXIMAL_GAP_NS)) {
+        printf("Invalid gap %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      g_arg_gap_ns = (uint64_t)(gap_us * 1000.0 + 0.5);
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--rate-pps") || 0 == strcmp(arg, "--rate-bps")) {
+      if (!has_next) {
+        printf("Required rate\n");
+        return parse_result_exit;
+      } else if (!parse_rate(next_arg, (0 == strcmp(arg, "--rate-pps")) ? &g_arg_rate_pps : &g_arg_rate_bps)) {
+        printf("Invalid rate %s\n", next_arg);
+        return parse_result_exit;
+      }
+
       ++argi;
     }
 
@@ -405,12 +856,234 @@ static parse_result_e parse_args(int argc, char **argv) {
       ++argi;
     }
 
+    else if (0 == strcmp(arg, "-b") || 0 == strcmp(arg, "--batch")) {
+      if (!has_next) {
+        printf("Required batch size\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_batch)) {
+        printf("Invalid batch size %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--gso")) {
+      if (!has_next) {
+        printf("Required GSO segments count\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_gso)) {
+        printf("Invalid GSO segments count %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "-e") || 0 == strcmp(arg, "--engine")) {
+      if (!has_next) {
+        printf("Required engine\n");
+        return parse_result_exit;
+      } else if (0 == strcmp(next_arg, "libuv")) {
+        g_arg_engine = engine_libuv;
+      } else if (0 == strcmp(next_arg, "io_uring")) {
+        g_arg_engine = engine_io_uring;
+      } else if (0 == strcmp(next_arg, "packet")) {
+        g_arg_engine = engine_packet;
+      } else {
+        printf("Unknown engine %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "-i") || 0 == strcmp(arg, "--interface")) {
+      if (!has_next) {
+        printf("Required interface\n");
+        return parse_result_exit;
+      } else {
+        g_arg_interface = next_arg;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--dst-mac")) {
+      if (!has_next) {
+        printf("Required destination MAC address\n");
+        return parse_result_exit;
+      }
+
+      const char *octet = next_arg;
+      size_t index = 0;
+      for (index = 0; index < countof(g_arg_destination_mac); ++index) {
+        char *end = NULL;
+        unsigned long value = strtoul(octet, &end, 16);
+
+        char separator = (index + 1 < countof(g_arg_destination_mac)) ? ':' : 0;
+        if (end == octet || end - octet > 2 || *end != separator) {
+          printf("Invalid destination MAC address %s\n", next_arg);
+          return parse_result_exit;
+        }
+
+        g_arg_destination_mac[index] = (uint8_t)value;
+        octet = end + 1;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "-d") || 0 == strcmp(arg, "--depth")) {
+      if (!has_next) {
+        printf("Required depth\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_depth)) {
+        printf("Invalid depth %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--payload-refresh")) {
+      if (!has_next) {
+        printf("Required payload refresh percent\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_payload_refresh)) {
+        printf("Invalid payload refresh percent %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--seed")) {
+      if (!has_next) {
+        printf("Required seed\n");
+        return parse_result_exit;
+      }
+
+      char *end = NULL;
+      g_arg_seed = strtoull(next_arg, &end, 0);
+      if (end == next_arg || 0 != *end) {
+        printf("Invalid seed %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      g_arg_is_seeded = true;
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--cpus")) {
+      if (!has_next) {
+        printf("Required CPU list\n");
+        return parse_result_exit;
+      } else if (0 != affinity_parse_list(next_arg, g_arg_cpus, countof(g_arg_cpus), &g_arg_cpus_count) ||
+                 0 == g_arg_cpus_count) {
+        printf("Invalid CPU list %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--numa")) {
+      g_arg_is_numa = true;
+    }
+
+    else if (0 == strcmp(arg, "--busy-poll")) {
+      g_arg_is_busy_poll = true;
+    }
+
+    else if (0 == strcmp(arg, "--sink")) {
+      g_arg_is_sink = true;
+    }
+
+    else if (0 == strcmp(arg, "--header")) {
+      g_arg_is_header = true;
+    }
+
+    else if (0 == strcmp(arg, "--reflect")) {
+      g_arg_is_sink = true;
+      g_arg_is_reflect = true;
+    } else if (0 == strcmp(arg, "--rtt")) {
+      g_arg_is_header = true;
+      g_arg_is_rtt = true;
+    }
+
+    else if (0 == strcmp(arg, "--mtu-discover")) {
+      if (!has_next) {
+        printf("Required MTU discovery mode\n");
+        return parse_result_exit;
+      } else if (0 == strcmp(next_arg, "want")) {
+        g_arg_mtu_discover = mtu_discover_want;
+      } else if (0 == strcmp(next_arg, "dont")) {
+        g_arg_mtu_discover = mtu_discover_dont;
+      } else if (0 == strcmp(next_arg, "do")) {
+        g_arg_mtu_discover = mtu_discover_do;
+      } else if (0 == strcmp(next_arg, "probe")) {
+        g_arg_mtu_discover = mtu_discover_probe;
+      } else {
+        printf("Unknown MTU discovery mode %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--zerocopy")) {
+      g_arg_is_zerocopy = true;
+    }
+
+    else if (0 == strcmp(arg, "--connect")) {
+      if (!has_next) {
+        printf("Required connected sockets count\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_connect)) {
+        printf("Invalid connected sockets count %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
+    else if (0 == strcmp(arg, "--source-ports")) {
+      if (!has_next) {
+        printf("Required source ports count\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_source_ports)) {
+        printf("Invalid source ports count %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--bind")) {
+      if (!has_next) {
+        printf("Required bind address\n");
+        return parse_result_exit;
+      } else {
+        g_arg_bind = next_arg;
+      }
+
+      ++argi;
+    } else if (0 == strcmp(arg, "--sndbuf")) {
+      if (!has_next) {
+        printf("Required send buffer size\n");
+        return parse_result_exit;
+      } else if (!parse_int(next_arg, &g_arg_sndbuf)) {
+        printf("Invalid send buffer size %s\n", next_arg);
+        return parse_result_exit;
+      }
+
+      ++argi;
+    }
+
     else {
       printf("Uknown option %s\n", arg);
       return parse_result_exit;
     }
   }
 
+  // the sizes of the profile are checked as the size range
+  if (NULL != s_size_profile && !parse_size_profile(s_size_profile)) {
+    return parse_result_exit;
+  }
+
   if (!(MINIMAL_PORT <= g_arg_port_min && g_arg_port_min <= g_arg_port_max && g_arg_port_max <= MAXIMAL_PORT)) {
     printf("Invalid minimal %d or maximal port %d\n", g_arg_port_min, g_arg_port_max);
     return parse_result_exit;
@@ -420,9 +1093,199 @@ static parse_result_e parse_args(int argc, char **argv) {
   } else if (!(MINIMAL_TIMEOUT <= g_arg_timeout_ms && g_arg_timeout_ms <= MAXIMAL_TIMEOUT)) {
     printf("Invalid timeout %d\n", g_arg_timeout_ms);
     return parse_result_exit;
+  } else if (0 != g_arg_gap_ns && 0 != g_arg_timeout_ms) {
+    printf("Use either timeout or gap\n");
+    return parse_result_exit;
+  } else if (0 != g_arg_rate_pps && !(MINIMAL_RATE <= g_arg_rate_pps && g_arg_rate_pps <= MAXIMAL_RATE_PPS)) {
+    printf("Invalid rate %" PRIu64 " datagrams per second\n", g_arg_rate_pps);
+    return parse_result_exit;
+  } else if (0 != g_arg_rate_bps && !(MINIMAL_RATE <= g_arg_rate_bps && g_arg_rate_bps <= MAXIMAL_RATE_BPS)) {
+    printf("Invalid rate %" PRIu64 " bits per second\n", g_arg_rate_bps);
+    return parse_result_exit;
   } else if (!(MINIMAL_WORKERS <= g_arg_workers_count && g_arg_workers_count <= MAXIMAL_WORKERS)) {
     printf("Invalid workers count %d\n", g_arg_workers_count);
     return parse_result_exit;
+  } else if (!(MINIMAL_BATCH <= g_arg_batch && g_arg_batch <= MAXIMAL_BATCH)) {
+    printf("Invalid batch size %d\n", g_arg_batch);
+    return parse_result_exit;
+  } else if (!(MINIMAL_GSO <= g_arg_gso && g_arg_gso <= MAXIMAL_GSO)) {
+    printf("Invalid GSO segments count %d\n", g_arg_gso);
+    return parse_result_exit;
+  } else if (!(MINIMAL_DEPTH <= g_arg_depth && g_arg_depth <= MAXIMAL_DEPTH)) {
+    printf("Invalid depth %d\n", g_arg_depth);
+    return parse_result_exit;
+  } else if (!(MINIMAL_PAYLOAD_REFRESH <= g_arg_payload_refresh && g_arg_payload_refresh <= MAXIMAL_PAYLOAD_REFRESH)) {
+    printf("Invalid payload refresh percent %d\n", g_arg_payload_refresh);
+    return parse_result_exit;
+  } else if (!(MINIMAL_SOURCE_PORTS <= g_arg_source_ports && g_arg_source_ports <= MAXIMAL_SOURCE_PORTS)) {
+    printf("Invalid source ports count %d\n", g_arg_source_ports);
+    return parse_result_exit;
+  } else if (!(MINIMAL_SNDBUF <= g_arg_sndbuf && g_arg_sndbuf <= MAXIMAL_SNDBUF)) {
+    printf("Invalid send buffer size %d\n", g_arg_sndbuf);
+    return parse_result_exit;
+  } else if (!(MINIMAL_CONNECT <= g_arg_connect && g_arg_connect <= MAXIMAL_CONNECT)) {
+    printf("Invalid connected sockets count %d\n", g_arg_connect);
+    return parse_result_exit;
+  } else if (!(MINIMAL_STATS_INTERVAL <= s_stats_interval_ms && s_stats_interval_ms <= MAXIMAL_STATS_INTERVAL)) {
+    printf("Invalid stats interval %d\n", s_stats_interval_ms);
+    return parse_result_exit;
+  }
+
+  if (NULL != s_stats_file && report_format_text == s_stats_format) {
+    printf("Stats file requires json or csv format\n");
+    return parse_result_exit;
+  }
+
+  // records take stdout if they do not have their own file
+  g_logger_is_stderr = report_format_text != s_stats_format && NULL == s_stats_file;
+
+  // other engines keep their own requests in flight
+  if (g_arg_depth > 1 && (g_arg_batch > 1 || engine_libuv != g_arg_engine)) {
+    printf("Depth is used only by the libuv engine without batches\n");
+    return parse_result_exit;
+  }
+
+#if !defined(PLATFORM_LINUX)
+  if (g_arg_batch > 1) {
+    printf("Batch sending is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (g_arg_gso > 1) {
+    printf("UDP GSO is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (engine_io_uring == g_arg_engine) {
+    printf("io_uring engine is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (engine_packet == g_arg_engine) {
+    printf("Packet engine is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (g_arg_cpus_count > 0 || g_arg_is_numa) {
+    printf("CPU list and NUMA placement are supported only on Linux\n");
+    return parse_result_exit;
+  } else if (g_arg_is_busy_poll) {
+    printf("Busy polling is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (g_arg_is_sink) {
+    printf("Sink is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (mtu_discover_default != g_arg_mtu_discover) {
+    printf("MTU discovery mode is supported only on Linux\n");
+    return parse_result_exit;
+  } else if (g_arg_is_zerocopy) {
+    printf("Zero-copy sending is supported only on Linux\n");
+    return parse_result_exit;
+  }
+#endif /*PLATFORM_LINUX*/
+
+#if defined(PLATFORM_LINUX)
+  if (g_arg_is_numa && 0 == g_arg_cpus_count) {
+    // the NIC node is known only for physical devices, other workers fill one node after another
+    int node = (NULL != g_arg_interface) ? affinity_interface_node(g_arg_interface) : -1;
+    if (0 != affinity_numa_cpus(node, g_arg_cpus, countof(g_arg_cpus), &g_arg_cpus_count) || 0 == g_arg_cpus_count) {
+      printf("NUMA nodes are unknown, use a CPU list\n");
+      return parse_result_exit;
+    }
+
+    if (node >= 0) {
+      logger_print_info("Workers use %zu CPUs of node %d near %s\n", g_arg_cpus_count, node, g_arg_interface);
+    }
+  }
+#endif /*PLATFORM_LINUX*/
+
+  if (g_arg_is_busy_poll) {
+    if (engine_libuv != g_arg_engine) {
+      printf("Busy polling replaces the send engine, it cannot be used with %s\n",
+             (engine_io_uring == g_arg_engine) ? "io_uring" : "packet");
+      return parse_result_exit;
+    } else if (g_arg_depth > 1 || 0 != g_arg_timeout_ms) {
+      printf("Busy polling sends without waiting for completions, use gap instead of depth and timeout\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (engine_packet == g_arg_engine) {
+    if (NULL == g_arg_interface) {
+      printf("Packet engine requires an interface\n");
+      return parse_result_exit;
+    } else if (g_arg_gso > 1) {
+      printf("Packet engine builds every datagram itself, UDP GSO cannot be used\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (g_arg_is_rtt) {
+    if (g_arg_is_sink) {
+      printf("Sink does not send, RTT cannot be measured\n");
+      return parse_result_exit;
+    } else if (g_arg_is_busy_poll || engine_libuv != g_arg_engine) {
+      printf("RTT receives replies on the libuv socket, it cannot be used with busy polling or other engines\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (g_arg_is_header) {
+    if (g_arg_size_min < PROBE_HEADER_SIZE) {
+      printf("Header requires datagrams of at least %d bytes\n", PROBE_HEADER_SIZE);
+      return parse_result_exit;
+    } else if (g_arg_gso > 1) {
+      printf("Header is written once for each send, UDP GSO cannot be used\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (engine_packet == g_arg_engine && (mtu_discover_default != g_arg_mtu_discover || g_arg_is_zerocopy)) {
+    printf("Packet engine does not fragment its frames, MTU discovery mode and zero-copy cannot be used\n");
+    return parse_result_exit;
+  } else if (g_arg_is_sink && (mtu_discover_default != g_arg_mtu_discover || g_arg_is_zerocopy)) {
+    printf("Sink does not send, MTU discovery mode and zero-copy cannot be used\n");
+    return parse_result_exit;
+  }
+
+  // the sink and the packet engine have their own source address and port
+  bool is_spread = g_arg_source_ports > 1 || NULL != g_arg_bind;
+  if (is_spread && (g_arg_is_sink || engine_packet == g_arg_engine)) {
+    printf("Source ports and bind addresses are used only by senders of the libuv and io_uring engines\n");
+    return parse_result_exit;
+  } else if (is_spread && g_arg_connect > 0) {
+    printf("Connected sockets have their own source ports, they cannot be used with source ports and bind addresses\n");
+    return parse_result_exit;
+  } else if (0 != g_arg_sndbuf && (g_arg_is_sink || engine_packet == g_arg_engine)) {
+    printf("Send buffer size is used only by UDP sockets of senders, the sink and the packet engine have none\n");
+    return parse_result_exit;
+  }
+
+  // batches and other engines send from the sockets of the worker
+  if (g_arg_connect > 0) {
+    if (g_arg_batch > 1 || g_arg_is_busy_poll || engine_libuv != g_arg_engine || g_arg_is_sink) {
+      printf("Connected sockets are used only by the libuv engine without batches, busy polling and sink\n");
+      return parse_result_exit;
+    } else if (g_arg_gso > 1 || g_arg_is_rtt) {
+      printf("Connected sockets cannot be used with UDP GSO and RTT, they are set up on the socket of the worker\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (g_arg_is_zerocopy) {
+    if (g_arg_batch < 2 && !g_arg_is_busy_poll) {
+      printf("Zero-copy sending uses sendmmsg, it requires batches or busy polling\n");
+      return parse_result_exit;
+    } else if (engine_libuv != g_arg_engine) {
+      printf("Zero-copy sending is not supported by the io_uring engine\n");
+      return parse_result_exit;
+    } else if (g_arg_is_header) {
+      printf("Headers are written again before the kernel sends them, zero-copy cannot be used with headers\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (g_arg_gso > 1) {
+    if (g_arg_size_min != g_arg_size_max) {
+      printf("UDP GSO requires a fixed datagram size\n");
+      return parse_result_exit;
+    } else if (g_arg_size_min * g_arg_gso > MAXIMAL_GSO_BYTES) {
+      printf("UDP GSO sends at most %d bytes at once, use at most %d segments\n", MAXIMAL_GSO_BYTES,
+             MAXIMAL_GSO_BYTES / g_arg_size_min);
+      return parse_result_exit;
+    }
   }
 
   bool is_ipv4 = strchr(g_arg_address, '.');
@@ -435,6 +1298,84 @@ static parse_result_e parse_args(int argc, char **argv) {
 
   g_arg_is_ipv4 = is_ipv4;
 
+  // the limit of IPv4 is checked only now, the family is known from the address
+  if (is_ipv4 && g_arg_size_max > MAXIMAL_SIZE_IPV4) {
+    printf("Invalid maximal size %d, IPv4 datagrams carry at most %d bytes\n", g_arg_size_max, MAXIMAL_SIZE_IPV4);
+    return parse_result_exit;
+  }
+
+  // numeric addresses are compiled once, only host names should be resolved for each datagram
+  int err = address_range_parse(&g_arg_address_range, g_arg_address, is_ipv4);
+  if (UV_EAI_NONAME == err && !strchr(g_arg_address, '/')) {
+    g_arg_is_numeric = false;
+  } else if (err) {
+    printf("Invalid address %s\n", g_arg_address);
+    return parse_result_exit;
+  } else {
+    g_arg_is_numeric = true;
+  }
+
+  if (NULL != g_arg_bind) {
+    bool is_bind_ipv4 = strchr(g_arg_bind, '.');
+    if (is_bind_ipv4 != is_ipv4 || 0 != address_range_parse(&g_arg_bind_range, g_arg_bind, is_ipv4)) {
+      printf("Invalid bind address %s, a numeric address or range of the destination family is required\n", g_arg_bind);
+      return parse_result_exit;
+    }
+
+    logger_print_trace("Bind address %s has %u variable bits\n", g_arg_bind, g_arg_bind_range.bits);
+  }
+
+  if (g_arg_is_numeric) {
+    logger_print_trace("Address %s has %u variable bits\n", g_arg_address, g_arg_address_range.bits);
+  } else {
+    logger_print_trace("Address %s is a host name\n", g_arg_address);
+  }
+
+  if (g_arg_batch > 1 && !g_arg_is_numeric) {
+    printf("Batch sending requires a numeric address\n");
+    return parse_result_exit;
+  } else if (engine_io_uring == g_arg_engine && !g_arg_is_numeric) {
+    printf("io_uring engine requires a numeric address\n");
+    return parse_result_exit;
+  } else if (g_arg_is_busy_poll && !g_arg_is_numeric) {
+    printf("Busy polling requires a numeric address\n");
+    return parse_result_exit;
+  }
+
+  if (g_arg_is_sink) {
+    if (!g_arg_is_numeric || 0 != g_arg_address_range.bits || g_arg_port_min != g_arg_port_max) {
+      printf("Sink requires one numeric address and one port\n");
+      return parse_result_exit;
+    } else if (g_arg_is_sweep || g_arg_is_busy_poll || engine_libuv != g_arg_engine) {
+      printf("Sink receives with recvmmsg, it cannot be used with sweep, busy polling or other engines\n");
+      return parse_result_exit;
+    } else if (g_arg_gso > 1 || g_arg_depth > 1 || 0 != g_arg_gap_ns || 0 != g_arg_rate_pps || 0 != g_arg_rate_bps) {
+      printf("Sink does not send, GSO, depth, gap and rates cannot be used\n");
+      return parse_result_exit;
+    }
+  }
+
+  if (g_arg_is_sweep) {
+    if (!g_arg_is_numeric) {
+      printf("Sweep requires a numeric address\n");
+      return parse_result_exit;
+    }
+
+    uint64_t seed = g_arg_is_seeded ? g_arg_seed : uv_hrtime();
+    if (!sweep_init(&g_sweep, &g_arg_address_range, g_arg_port_min, g_arg_port_max, seed)) {
+      printf("Sweep space is too large, %u address bits and %d ports\n", g_arg_address_range.bits,
+             g_arg_port_max - g_arg_port_min + 1);
+      return parse_result_exit;
+    }
+
+    // workers step over the positions by the workers count, extra workers would repeat the positions of others
+    if ((uint64_t)g_arg_workers_count > g_sweep.size) {
+      g_arg_workers_count = (int)g_sweep.size;
+    }
+
+    logger_print_info("Sweeping %" PRIu64 " destinations with %d workers\n", g_sweep.size, g_arg_workers_count);
+  }
+
   return parse_result_continue;
 }
 
@@ -497,34 +1438,183 @@ static void humanize_operations(char *buffer, size_t buffer_length, uint64_t ope
   }
 }
 
+static void humanize_latency(char *buffer, size_t buffer_length, uint64_t latency_ns) {
+  if (s_stats_raw) {
+    sprintf_s(buffer, buffer_length, "%" PRIu64, latency_ns);
+  } else if (latency_ns < 1000ull) {
+    sprintf_s(buffer, buffer_length, "%" PRIu64 " ns", latency_ns);
+  } else if (latency_ns < 1000ull * 1000) {
+    sprintf_s(buffer, buffer_length, "%.1f us", latency_ns / 1.0E3f);
+  } else if (latency_ns < 1000ull * 1000 * 1000) {
+    sprintf_s(buffer, buffer_length, "%.2f ms", latency_ns / 1.0E6f);
+  } else {
+    sprintf_s(buffer, buffer_length, "%.2f s", latency_ns / 1.0E9f);
+  }
+}
+
+static void format_latency(char *buffer, size_t buffer_length, const histogram_values_t *values) {
+  char p50_str[64] = {0};
+  humanize_latency(p50_str, countof(p50_str), histogram_percentile(values, 50.0));
+
+  char p99_str[64] = {0};
+  humanize_latency(p99_str, countof(p99_str), histogram_percentile(values, 99.0));
+
+  char p999_str[64] = {0};
+  humanize_latency(p999_str, countof(p999_str), histogram_percentile(values, 99.9));
+
+  char max_str[64] = {0};
+  humanize_latency(max_str, countof(max_str), values->maximum);
+
+  sprintf_s(buffer, buffer_length, "p50 %s, p99 %s, p99.9 %s, max %s", p50_str, p99_str, p999_str, max_str);
+}
+
 static void stats_handler(uv_timer_t *timer) {
   (void)timer;
 
   uint64_t time_ns = uv_hrtime();
   uint64_t total_ns = time_ns - s_stats_start_ns;
+  uint64_t tick_ns = time_ns - s_stats_prev_ns;
   s_stats_prev_ns = time_ns;
 
-  uint64_t total_bytes = (uint64_t)custom_atomic_load(&g_stats_sent_bytes);
-  uint64_t tick_bytes = total_bytes - s_stats_prev_sent_bytes;
-  s_stats_prev_sent_bytes = total_bytes;
+  // the timer could be late, so rates are computed for the real length of the tick
+  double tick_sec = tick_ns ? tick_ns / 1.0E9 : 1.0;
+
+  // records take stdout if they do not have their own file
+  bool is_text = report_format_text == s_stats_format || NULL != s_stats_file;
+
+  report_begin(total_ns, tick_ns);
+
+  // each worker owns its counters, they are summed once per tick
+  stats_values_t total = {0};
+  stats_values_t tick = {0};
+
+  unsigned int index = 0;
+  for (index = 1; index <= (unsigned int)g_arg_workers_count; ++index) {
+    stats_values_t worker_total = {0};
+    stats_values_t worker_tick = {0};
+    stats_collect(index, &worker_total, &worker_tick);
+
+    stats_add(&total, &worker_total);
+    stats_add(&tick, &worker_tick);
+
+    report_values(index, &worker_tick, &worker_total);
 
-  uint64_t total_operations = (uint64_t)custom_atomic_load(&g_stats_sent_operations);
-  uint64_t tick_operations = total_operations - s_stats_prev_sent_operations;
-  s_stats_prev_sent_operations = total_operations;
+    if (g_logger_level < LOGGER_LEVEL_TRACE || !is_text) {
+      continue;
+    }
+
+    uint64_t worker_bytes = (uint64_t)(worker_tick.sent_bytes / tick_sec);
+    uint64_t worker_operations = (uint64_t)(worker_tick.sent_operations / tick_sec);
+    uint64_t worker_syscalls = (uint64_t)(worker_tick.sent_syscalls / tick_sec);
+
+    if (s_stats_raw) {
+      logger_print_trace("#%u: %" PRIu64 " bytes/s and %" PRIu64 " op/s, %" PRIu64 " syscalls/s, %" PRIu64 " in flight\n",
+                         index, worker_bytes, worker_operations, worker_syscalls, worker_tick.sent_inflight);
+    } else {
+      char worker_bytes_str[64] = {0};
+      humanize_bytes(worker_bytes_str, countof(worker_bytes_str), worker_bytes);
+
+      char worker_operations_str[64] = {0};
+      humanize_operations(worker_operations_str, countof(worker_operations_str), worker_operations);
+
+      logger_print_trace("#%u: %s/s and %s/s, %" PRIu64 " syscalls/s, %" PRIu64 " in flight\n", index, worker_bytes_str,
+                         worker_operations_str, worker_syscalls, worker_tick.sent_inflight);
+    }
+  }
+
+  report_end(&tick, &total);
+
+  if (!is_text) {
+    return;
+  }
+
+  double tick_batch = tick.sent_syscalls ? (double)tick.sent_operations / (double)tick.sent_syscalls : 0.0;
+
+  char details_str[256] = {0};
+  if (g_arg_gso > 1) {
+    sprintf_s(details_str, countof(details_str), ", %.2f segments/send",
+              tick.sent_messages ? (double)tick.sent_operations / (double)tick.sent_messages : 0.0);
+  }
+
+  // the pipeline is the bottleneck if it is always full
+  size_t pipeline = 0;
+  if (g_arg_depth > 1) {
+    pipeline = (size_t)g_arg_workers_count * g_arg_depth;
+  } else if (engine_io_uring == g_arg_engine) {
+    pipeline = (size_t)g_arg_workers_count * g_arg_batch;
+  }
+
+  if (pipeline > 0) {
+    size_t length = strlen(details_str);
+    sprintf_s(details_str + length, countof(details_str) - length, ", %" PRIu64 " of %zu in flight", total.sent_inflight,
+              pipeline);
+  }
+
+  // fragments are shown only if datagrams are larger than the MTU
+  if (tick.sent_fragments > tick.sent_operations) {
+    size_t length = strlen(details_str);
+    sprintf_s(details_str + length, countof(details_str) - length, ", %.2f fragments/datagram",
+              (double)tick.sent_fragments / (double)tick.sent_operations);
+  }
+
+  if (g_arg_connect > 0) {
+    size_t length = strlen(details_str);
+    sprintf_s(details_str + length, countof(details_str) - length, ", %" PRIu64 " connects", tick.sent_connects);
+  }
+
+  if (0 != tick.sent_errors) {
+    size_t length = strlen(details_str);
+    sprintf_s(details_str + length, countof(details_str) - length, ", %" PRIu64 " failed", tick.sent_errors);
+  }
+
+  if (0 != total.probe_latency.count) {
+    size_t length = strlen(details_str);
+    sprintf_s(details_str + length, countof(details_str) - length,
+              ", %" PRIu64 " missing, %" PRIu64 " reordered, %" PRIu64 " duplicates", total.probe_missing,
+              tick.probe_reordered, tick.probe_duplicates);
+  }
+
+  if (0 != g_size_profile.count) {
+    size_t length = strlen(details_str);
+    sprintf_s(details_str + length, countof(details_str) - length, ", mean %.1f bytes",
+              tick.sent_operations ? (double)tick.sent_bytes / (double)tick.sent_operations : 0.0);
+  }
+
+  if (0 != g_arg_rate_pps) {
+    char target_str[64] = {0};
+    humanize_operations(target_str, countof(target_str), g_arg_rate_pps);
+
+    size_t length = strlen(details_str);
+    double achieved = 100.0 * tick.sent_operations / tick_sec / g_arg_rate_pps;
+    sprintf_s(details_str + length, countof(details_str) - length, ", %.2f%% of %s/s", achieved, target_str);
+  }
+
+  if (0 != g_arg_rate_bps) {
+    char target_str[64] = {0};
+    humanize_bytes(target_str, countof(target_str), g_arg_rate_bps / 8);
+
+    size_t length = strlen(details_str);
+    double achieved = 800.0 * tick.sent_bytes / tick_sec / g_arg_rate_bps;
+    sprintf_s(details_str + length, countof(details_str) - length, ", %.2f%% of %s/s", achieved, target_str);
+  }
+
+  uint64_t tick_bytes = (uint64_t)(tick.sent_bytes / tick_sec);
+  uint64_t tick_operations = (uint64_t)(tick.sent_operations / tick_sec);
 
   if (s_stats_raw) {
-    logger_print_info("Elapsed %" PRIu64 " ms, %" PRIu64 " bytes/s and %" PRIu64 " op/s, total %" PRIu64 " bytes and %" PRIu64
-                      " operations\n",
-                      total_ns / (1 * 1000 * 1000), tick_bytes, tick_operations, total_bytes, total_operations);
+    logger_print_info("Elapsed %" PRIu64 " ms, %" PRIu64 " bytes/s and %" PRIu64 " op/s, %.2f op/syscall%s, total %" PRIu64
+                      " bytes and %" PRIu64 " operations\n",
+                      total_ns / (1 * 1000 * 1000), tick_bytes, tick_operations, tick_batch, details_str,
+                      total.sent_bytes, total.sent_operations);
   } else {
     char time_str[64] = {0};
     humanize_time(time_str, countof(time_str), total_ns);
 
     char total_bytes_str[64] = {0};
-    humanize_bytes(total_bytes_str, countof(total_bytes_str), total_bytes);
+    humanize_bytes(total_bytes_str, countof(total_bytes_str), total.sent_bytes);
 
     char total_operations_str[64] = {0};
-    humanize_operations(total_operations_str, countof(total_operations_str), total_operations);
+    humanize_operations(total_operations_str, countof(total_operations_str), total.sent_operations);
 
     char tick_bytes_str[64] = {0};
     humanize_bytes(tick_bytes_str, countof(tick_bytes_str), tick_bytes);
@@ -532,7 +1622,102 @@ static void stats_handler(uv_timer_t *timer) {
     char tick_operations_str[64] = {0};
     humanize_operations(tick_operations_str, countof(tick_operations_str), tick_operations);
 
-    logger_print_info("Elapsed %s, %s/s and %s/s, total %s and %s\n", time_str, tick_bytes_str, tick_operations_str,
-                      total_bytes_str, total_operations_str);
+    logger_print_info("Elapsed %s, %s/s and %s/s, %.2f op/syscall%s, total %s and %s\n", time_str, tick_bytes_str,
+                      tick_operations_str, tick_batch, details_str, total_bytes_str, total_operations_str);
+  }
+
+  if (0 != tick.schedule_latency.count || 0 != tick.send_latency.count) {
+    char schedule_str[256] = {0};
+    format_latency(schedule_str, countof(schedule_str), &tick.schedule_latency);
+
+    char send_str[256] = {0};
+    format_latency(send_str, countof(send_str), &tick.send_latency);
+
+    logger_print_info("Latency%s to submit %s, submit to completion %s\n", s_stats_raw ? " in ns, due" : ", due",
+                      schedule_str, send_str);
+  }
+
+  if (0 != tick.probe_latency.count) {
+    char probe_str[256] = {0};
+    format_latency(probe_str, countof(probe_str), &tick.probe_latency);
+
+    logger_print_info("One-way latency%s %s\n", s_stats_raw ? " in ns" : "", probe_str);
   }
+
+  if (0 != tick.rtt_latency.count) {
+    char rtt_str[256] = {0};
+    format_latency(rtt_str, countof(rtt_str), &tick.rtt_latency);
+
+    logger_print_info("Round trip time%s of %" PRIu64 " replies %s\n", s_stats_raw ? " in ns" : "",
+                      tick.rtt_latency.count, rtt_str);
+  }
+}
+
+static void stats_dump_histogram(const char *name, const histogram_values_t *values) {
+  if (0 == values->count) {
+    return;
+  }
+
+  logger_print_info("Latency from %s of %" PRIu64 " datagrams%s:\n", name, values->count, s_stats_raw ? " in ns" : "");
+
+  // only the buckets with values are shown, every line has the highest value of its bucket
+  uint64_t seen = 0;
+  size_t index = 0;
+  for (index = 0; index < HISTOGRAM_BUCKETS; ++index) {
+    if (0 == values->counts[index]) {
+      continue;
+    }
+
+    seen += values->counts[index];
+
+    uint64_t value = histogram_bucket_maximum(index);
+    char value_str[64] = {0};
+    humanize_latency(value_str, countof(value_str), (value < values->maximum) ? value : values->maximum);
+
+    logger_print_info("  <= %s: %" PRIu64 " (%.3f%%, %.3f%% total)\n", value_str, values->counts[index],
+                      100.0 * values->counts[index] / values->count, 100.0 * seen / values->count);
+  }
+}
+
+static void stats_dump_sizes(const stats_values_t *values) {
+  uint64_t count = 0;
+  double mean = profile_mean(&g_size_profile, values->profile_counts, &count);
+  if (0 == count) {
+    return;
+  }
+
+  logger_print_info("Sizes of %" PRIu64 " datagrams, mean %.1f bytes of expected %.1f:\n", count, mean,
+                    g_size_profile.mean);
+
+  double weights = 0.0;
+  unsigned int index = 0;
+  for (index = 0; index < g_size_profile.count; ++index) {
+    weights += g_size_profile.weights[index];
+  }
+
+  for (index = 0; index < g_size_profile.count; ++index) {
+    logger_print_info("  %d bytes: %" PRIu64 " (%.3f%% of expected %.3f%%)\n", g_size_profile.sizes[index],
+                      values->profile_counts[index], 100.0 * values->profile_counts[index] / count,
+                      100.0 * g_size_profile.weights[index] / weights);
+  }
+}
+
+static void stats_dump(void) {
+  // the workers are stopped, so the totals are final
+  stats_values_t total = {0};
+
+  unsigned int index = 0;
+  for (index = 1; index <= (unsigned int)g_arg_workers_count; ++index) {
+    stats_values_t worker_total = {0};
+    stats_values_t worker_tick = {0};
+    stats_collect(index, &worker_total, &worker_tick);
+
+    stats_add(&total, &worker_total);
+  }
+
+  stats_dump_histogram("the deadline to the submission", &total.schedule_latency);
+  stats_dump_histogram("the submission to the completion", &total.send_latency);
+  stats_dump_histogram("the header to the reception", &total.probe_latency);
+  stats_dump_histogram("the header to the reply", &total.rtt_latency);
+  stats_dump_sizes(&total);
 }
@@ -0,0 +1,539 @@
+#include "./metrics.h"
+#include "./globals.h"
+#include "./logger.h"
+#include "./platform.h"
+#include "./stats.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define METRICS_BACKLOG 16
+#define METRICS_REQUEST_SIZE 4096
+#define METRICS_HEADER_SIZE 256
+#define METRICS_BUFFER_SIZE (64 * 1024)
+
+#undef countof
+#define countof(_x) (sizeof((_x)) / sizeof((_x)[0]))
+
+typedef struct _metrics_buffer_t {
+  char *data;
+  size_t length;
+  size_t capacity;
+  bool is_failed;
+} metrics_buffer_t;
+
+typedef struct _metrics_client_t {
+  // the handle goes first, so the handle pointer is the client pointer
+  union {
+    uv_tcp_t tcp;
+    uv_pipe_t pipe;
+  } handle;
+
+  uv_write_t write_request;
+
+  char request[METRICS_REQUEST_SIZE];
+  size_t request_length;
+
+  char header[METRICS_HEADER_SIZE];
+  metrics_buffer_t body;
+
+  struct _metrics_client_t *prev;
+  struct _metrics_client_t *next;
+} metrics_client_t;
+
+// scalar counters of one worker, the histograms are summed right away
+typedef struct _metrics_worker_t {
+  uint64_t sent_bytes;
+  uint64_t sent_operations;
+  uint64_t sent_messages;
+  uint64_t sent_syscalls;
+  uint64_t sent_inflight;
+  uint64_t sent_errors;
+  uint64_t sent_fragments;
+  uint64_t sent_connects;
+  uint64_t probe_missing;
+  uint64_t probe_reordered;
+  uint64_t probe_duplicates;
+} metrics_worker_t;
+
+static bool s_metrics_is_pipe = false;
+static const char *s_metrics_path = NULL;
+static uv_tcp_t s_metrics_tcp;
+static uv_pipe_t s_metrics_pipe;
+static uv_stream_t *s_metrics_server = NULL;
+static metrics_client_t *s_metrics_clients = NULL;
+
+static void metrics_connection(uv_stream_t *server, int status);
+static void metrics_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf);
+static void metrics_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf);
+static void metrics_respond(metrics_client_t *client);
+static void metrics_written(uv_write_t *req, int status);
+static void metrics_close_client(metrics_client_t *client);
+static void metrics_client_closed(uv_handle_t *handle);
+static void metrics_server_closed(uv_handle_t *handle);
+
+static bool metrics_build(metrics_buffer_t *buffer);
+static void metrics_build_counter(metrics_buffer_t *buffer, const char *name, const char *type, const char *help,
+                                  const metrics_worker_t *workers, size_t offset);
+static void metrics_build_histogram(metrics_buffer_t *buffer, const char *name, const char *help,
+                                    const histogram_values_t *values);
+static void metrics_print(metrics_buffer_t *buffer, const char *format, ...);
+
+int metrics_start(uv_loop_t *loop, const char *address) {
+  assert(NULL != loop);
+  assert(NULL != address);
+  assert(NULL == s_metrics_server);
+
+  int err = 0;
+  if (0 == strncmp(address, "unix:", 5)) {
+    s_metrics_is_pipe = true;
+
+    err = uv_pipe_init(loop, &s_metrics_pipe, 0);
+    if (err) {
+      return err;
+    }
+
+    s_metrics_server = (uv_stream_t *)&s_metrics_pipe;
+
+    err = uv_pipe_bind(&s_metrics_pipe, address + 5);
+    if (0 == err) {
+      s_metrics_path = address + 5;
+    }
+  } else {
+    s_metrics_is_pipe = false;
+
+    // the port could go alone, with a host or with a bracketed IPv6 host
+    char host[64] = "127.0.0.1";
+    const char *port = strrchr(address, ':');
+    if (NULL != port) {
+      const char *first = address;
+      const char *last = port;
+      if ('[' == *first && ']' == *(last - 1)) {
+        ++first;
+        --last;
+      }
+
+      if (last <= first || (size_t)(last - first) >= sizeof(host)) {
+        return UV_EINVAL;
+      }
+
+      memcpy(host, first, last - first);
+      host[last - first] = 0;
+      ++port;
+    } else {
+      port = address;
+    }
+
+    char *end = NULL;
+    unsigned long port_number = strtoul(port, &end, 10);
+    if (end == port || 0 != *end || port_number > 65535) {
+      return UV_EINVAL;
+    }
+
+    sockaddr_any sockaddr;
+    if (strchr(host, ':')) {
+      err = uv_ip6_addr(host, (int)port_number, &sockaddr.addr6);
+    } else {
+      err = uv_ip4_addr(host, (int)port_number, &sockaddr.addr4);
+    }
+
+    if (err) {
+      return err;
+    }
+
+    err = uv_tcp_init(loop, &s_metrics_tcp);
+    if (err) {
+      return err;
+    }
+
+    s_metrics_server = (uv_stream_t *)&s_metrics_tcp;
+
+    err = uv_tcp_bind(&s_metrics_tcp, &sockaddr.addr, 0);
+  }
+
+  if (0 == err) {
+    err = uv_listen(s_metrics_server, METRICS_BACKLOG, metrics_connection);
+  }
+
+  if (err) {
+    metrics_stop();
+    return err;
+  }
+
+  return 0;
+}
+
+void metrics_stop(void) {
+  if (NULL == s_metrics_server) {
+    return;
+  }
+
+  while (NULL != s_metrics_clients) {
+    metrics_close_client(s_metrics_clients);
+  }
+
+  uv_close((uv_handle_t *)s_metrics_server, metrics_server_closed);
+  s_metrics_server = NULL;
+
+#if !defined(PLATFORM_WINDOWS)
+  // a Unix socket stays in the file system after it is closed
+  if (NULL != s_metrics_path) {
+    uv_fs_t req;
+    uv_fs_unlink(s_metrics_pipe.loop, &req, s_metrics_path, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+#endif /*PLATFORM_WINDOWS*/
+
+  s_metrics_path = NULL;
+}
+
+static void metrics_connection(uv_stream_t *server, int status) {
+  assert(NULL != server);
+
+  if (status) {
+    logger_print_error("Metrics connection failed: %s\n", uv_strerror(status));
+    return;
+  }
+
+  metrics_client_t *client = (metrics_client_t *)calloc(1, sizeof(*client));
+  if (NULL == client) {
+    logger_print_error("calloc failed: %s\n", uv_strerror(UV_ENOMEM));
+    return;
+  }
+
+  int err = s_metrics_is_pipe ? uv_pipe_init(server->loop, &client->handle.pipe, 0)
+                              : uv_tcp_init(server->loop, &client->handle.tcp);
+  if (err) {
+    logger_print_error("Metrics connection failed: %s\n", uv_strerror(err));
+    free(client);
+    return;
+  }
+
+  client->next = s_metrics_clients;
+  if (NULL != s_metrics_clients) {
+    s_metrics_clients->prev = client;
+  }
+
+  s_metrics_clients = client;
+
+  err = uv_accept(server, (uv_stream_t *)&client->handle);
+  if (0 == err) {
+    err = uv_read_start((uv_stream_t *)&client->handle, metrics_alloc, metrics_read);
+  }
+
+  if (err) {
+    logger_print_error("Metrics connection failed: %s\n", uv_strerror(err));
+    metrics_close_client(client);
+    return;
+  }
+}
+
+static void metrics_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf) {
+  assert(NULL != handle);
+  (void)suggested_size;
+
+  // the request is read into the client, the last byte keeps the terminating zero
+  metrics_client_t *client = (metrics_client_t *)handle;
+  buf->base = client->request + client->request_length;
+  buf->len = (unsigned int)(sizeof(client->request) - client->request_length - 1);
+}
+
+static void metrics_read(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf) {
+  assert(NULL != stream);
+  (void)buf;
+
+  metrics_client_t *client = (metrics_client_t *)stream;
+
+  if (nread < 0) {
+    metrics_close_client(client);
+    return;
+  }
+
+  client->request_length += (size_t)nread;
+  client->request[client->request_length] = 0;
+
+  // the request body is never used, the headers end the request
+  bool is_complete = strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n");
+  if (is_complete || client->request_length + 1 >= sizeof(client->request)) {
+    uv_read_stop(stream);
+    metrics_respond(client);
+  }
+}
+
+static void metrics_respond(metrics_client_t *client) {
+  assert(NULL != client);
+
+  const char *status = "200 OK";
+  if (0 != strncmp(client->request, "GET ", 4)) {
+    status = "405 Method Not Allowed";
+  } else if (!metrics_build(&client->body)) {
+    status = "500 Internal Server Error";
+    client->body.length = 0;
+  }
+
+  sprintf_s(client->header, countof(client->header),
+            "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+            status, client->body.length);
+
+  uv_buf_t bufs[2];
+  bufs[0] = uv_buf_init(client->header, (unsigned int)strlen(client->header));
+  bufs[1] = uv_buf_init(client->body.data, (unsigned int)client->body.length);
+
+  int err = uv_write(&client->write_request, (uv_stream_t *)&client->handle, bufs, client->body.length ? 2 : 1,
+                     metrics_written);
+  if (err) {
+    metrics_close_client(client);
+    return;
+  }
+}
+
+static void metrics_written(uv_write_t *req, int status) {
+  assert(NULL != req);
+  (void)status;
+
+  metrics_client_t *client = (metrics_client_t *)req->handle;
+  metrics_close_client(client);
+}
+
+static void metrics_close_client(metrics_client_t *client) {
+  assert(NULL != client);
+
+  if (NULL != client->prev) {
+    client->prev->next = client->next;
+  } else if (s_metrics_clients == client) {
+    s_metrics_clients = client->next;
+  } else {
+    // the client is already closing
+    return;
+  }
+
+  if (NULL != client->next) {
+    client->next->prev = client->prev;
+  }
+
+  client->prev = client->next = NULL;
+
+  uv_close((uv_handle_t *)&client->handle, metrics_client_closed);
+}
+
+static void metrics_client_closed(uv_handle_t *handle) {
+  assert(NULL != handle);
+
+  metrics_client_t *client = (metrics_client_t *)handle;
+  free(client->body.data);
+  free(client);
+}
+
+static void metrics_server_closed(uv_handle_t *handle) {
+  (void)handle;
+
+  // do nothing
+}
+
+static bool metrics_build(metrics_buffer_t *buffer) {
+  assert(NULL != buffer);
+
+  metrics_worker_t *workers = (metrics_worker_t *)calloc(g_arg_workers_count, sizeof(*workers));
+  stats_values_t *total = (stats_values_t *)calloc(1, sizeof(*total));
+  stats_values_t *worker_total = (stats_values_t *)malloc(sizeof(*worker_total));
+  if (NULL == workers || NULL == total || NULL == worker_total) {
+    free(workers);
+    free(total);
+    free(worker_total);
+    return false;
+  }
+
+  // the counters are only loaded, the workers and the stats timer do not notice the scrape
+  unsigned int index = 0;
+  for (index = 1; index <= (unsigned int)g_arg_workers_count; ++index) {
+    stats_read(index, worker_total);
+    stats_add(total, worker_total);
+
+    metrics_worker_t *worker = &workers[index - 1];
+    worker->sent_bytes = worker_total->sent_bytes;
+    worker->sent_operations = worker_total->sent_operations;
+    worker->sent_messages = worker_total->sent_messages;
+    worker->sent_syscalls = worker_total->sent_syscalls;
+    worker->sent_inflight = worker_total->sent_inflight;
+    worker->sent_errors = worker_total->sent_errors;
+    worker->sent_fragments = worker_total->sent_fragments;
+    worker->sent_connects = worker_total->sent_connects;
+    worker->probe_missing = worker_total->probe_missing;
+    worker->probe_reordered = worker_total->probe_reordered;
+    worker->probe_duplicates = worker_total->probe_duplicates;
+  }
+
+  metrics_print(buffer, "# HELP udp_flood_workers Count of workers.\n");
+  metrics_print(buffer, "# TYPE udp_flood_workers gauge\n");
+  metrics_print(buffer, "udp_flood_workers %d\n", g_arg_workers_count);
+
+  // the sink counts received datagrams in the counters of sends, they are exported under their own names
+  if (g_arg_is_sink) {
+    metrics_build_counter(buffer, "udp_flood_received_bytes_total", "counter", "Payload bytes received.", workers,
+                          offsetof(metrics_worker_t, sent_bytes));
+    metrics_build_counter(buffer, "udp_flood_received_datagrams_total", "counter", "Datagrams received.", workers,
+                          offsetof(metrics_worker_t, sent_operations));
+    metrics_build_counter(buffer, "udp_flood_syscalls_total", "counter", "System calls of receives and replies.", workers,
+                          offsetof(metrics_worker_t, sent_syscalls));
+    metrics_build_counter(buffer, "udp_flood_receive_errors_total", "counter",
+                          "Receives refused by the OS and replies dropped by the reflector.", workers,
+                          offsetof(metrics_worker_t, sent_errors));
+  } else {
+    metrics_build_counter(buffer, "udp_flood_sent_bytes_total", "counter", "Payload bytes sent.", workers,
+                          offsetof(metrics_worker_t, sent_bytes));
+    metrics_build_counter(buffer, "udp_flood_sent_datagrams_total", "counter", "Datagrams sent.", workers,
+                          offsetof(metrics_worker_t, sent_operations));
+    metrics_build_counter(buffer, "udp_flood_sent_fragments_total", "counter",
+                          "IP packets sent, a datagram larger than the MTU is split into several fragments.", workers,
+                          offsetof(metrics_worker_t, sent_fragments));
+    metrics_build_counter(buffer, "udp_flood_sent_messages_total", "counter",
+                          "Messages sent, one message has several datagrams with UDP GSO.", workers,
+                          offsetof(metrics_worker_t, sent_messages));
+    metrics_build_counter(buffer, "udp_flood_syscalls_total", "counter", "System calls of sends.", workers,
+                          offsetof(metrics_worker_t, sent_syscalls));
+    metrics_build_counter(buffer, "udp_flood_send_errors_total", "counter", "Sends refused by the OS.", workers,
+                          offsetof(metrics_worker_t, sent_errors));
+    metrics_build_counter(buffer, "udp_flood_connects_total", "counter",
+                          "Sockets of the connected socket cache connected to a new destination.", workers,
+                          offsetof(metrics_worker_t, sent_connects));
+    metrics_build_counter(buffer, "udp_flood_sends_in_flight", "gauge", "Sends waiting for completion.", workers,
+                          offsetof(metrics_worker_t, sent_inflight));
+  }
+
+  metrics_build_counter(buffer, "udp_flood_received_missing_datagrams", "gauge",
+                        "Datagrams with headers not received by the sink yet.", workers,
+                        offsetof(metrics_worker_t, probe_missing));
+  metrics_build_counter(buffer, "udp_flood_received_reordered_total", "counter",
+                        "Datagrams with headers received by the sink after a later one.", workers,
+                        offsetof(metrics_worker_t, probe_reordered));
+  metrics_build_counter(buffer, "udp_flood_received_duplicates_total", "counter",
+                        "Datagrams with headers received by the sink more than once.", workers,
+                        offsetof(metrics_worker_t, probe_duplicates));
+
+  if (0 != g_size_profile.count) {
+    metrics_print(buffer, "# HELP udp_flood_profile_datagrams_total Datagrams of each entry of the size profile.\n");
+    metrics_print(buffer, "# TYPE udp_flood_profile_datagrams_total counter\n");
+
+    unsigned int entry = 0;
+    for (entry = 0; entry < g_size_profile.count; ++entry) {
+      metrics_print(buffer, "udp_flood_profile_datagrams_total{entry=\"%u\",size=\"%d\"} %" PRIu64 "\n", entry,
+                    g_size_profile.sizes[entry], total->profile_counts[entry]);
+    }
+  }
+
+  metrics_build_histogram(buffer, "udp_flood_schedule_latency_seconds",
+                          "Time from the moment a send is due to its submission, the sum is estimated from the buckets.",
+                          &total->schedule_latency);
+  metrics_build_histogram(buffer, "udp_flood_send_latency_seconds",
+                          "Time from the submission of a send to its completion, the sum is estimated from the buckets.",
+                          &total->send_latency);
+  metrics_build_histogram(buffer, "udp_flood_one_way_latency_seconds",
+                          "Time from the send time of a header to its reception, the sum is estimated from the buckets.",
+                          &total->probe_latency);
+  metrics_build_histogram(buffer, "udp_flood_rtt_seconds",
+                          "Round trip time of a header and its reply, the sum is estimated from the buckets.",
+                          &total->rtt_latency);
+
+  free(workers);
+  free(total);
+  free(worker_total);
+
+  return !buffer->is_failed;
+}
+
+static void metrics_build_counter(metrics_buffer_t *buffer, const char *name, const char *type, const char *help,
+                                  const metrics_worker_t *workers, size_t offset) {
+  assert(NULL != buffer);
+  assert(NULL != name);
+  assert(NULL != type);
+  assert(NULL != help);
+  assert(NULL != workers);
+
+  metrics_print(buffer, "# HELP %s %s\n", name, help);
+  metrics_print(buffer, "# TYPE %s %s\n", name, type);
+
+  int index = 0;
+  for (index = 0; index < g_arg_workers_count; ++index) {
+    uint64_t value = *(const uint64_t *)((const uint8_t *)&workers[index] + offset);
+    metrics_print(buffer, "%s{worker=\"%d\"} %" PRIu64 "\n", name, index + 1, value);
+  }
+}
+
+static void metrics_build_histogram(metrics_buffer_t *buffer, const char *name, const char *help,
+                                    const histogram_values_t *values) {
+  assert(NULL != buffer);
+  assert(NULL != name);
+  assert(NULL != help);
+  assert(NULL != values);
+
+  metrics_print(buffer, "# HELP %s %s\n", name, help);
+  metrics_print(buffer, "# TYPE %s histogram\n", name);
+
+  // buckets of the exported histogram are powers of two, the last group of the histogram has no upper bound
+  uint64_t count = 0;
+  double sum = 0.0;
+  uint64_t minimum = 0;
+
+  size_t index = 0;
+  for (index = 0; index < HISTOGRAM_BUCKETS; ++index) {
+    uint64_t maximum = histogram_bucket_maximum(index);
+    uint64_t middle = (index + 1 < HISTOGRAM_BUCKETS) ? minimum + (maximum - minimum) / 2 : minimum;
+
+    count += values->counts[index];
+    sum += (double)middle * (double)values->counts[index];
+    minimum = maximum + 1;
+
+    if ((index + 1) % HISTOGRAM_SUB_COUNT == 0 && index + 1 < HISTOGRAM_BUCKETS) {
+      metrics_print(buffer, "%s_bucket{le=\"%g\"} %" PRIu64 "\n", name, minimum / 1.0E9, count);
+    }
+  }
+
+  metrics_print(buffer, "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", name, count);
+  metrics_print(buffer, "%s_sum %.9f\n", name, sum / 1.0E9);
+  metrics_print(buffer, "%s_count %" PRIu64 "\n", name, count);
+}
+
+static void metrics_print(metrics_buffer_t *buffer, const char *format, ...) {
+  assert(NULL != buffer);
+  assert(NULL != format);
+
+  if (buffer->is_failed) {
+    return;
+  }
+
+  // a response without some lines would be wrong, so the whole response fails if the buffer cannot grow
+  int attempt = 0;
+  for (attempt = 0; attempt < 2; ++attempt) {
+    if (attempt > 0 || NULL == buffer->data) {
+      size_t capacity = buffer->capacity ? buffer->capacity * 2 : METRICS_BUFFER_SIZE;
+      char *data = (char *)realloc(buffer->data, capacity);
+      if (NULL == data) {
+        buffer->is_failed = true;
+        return;
+      }
+
+      buffer->data = data;
+      buffer->capacity = capacity;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer->data + buffer->length, buffer->capacity - buffer->length, format, args);
+    va_end(args);
+
+    if (length < 0) {
+      buffer->is_failed = true;
+      return;
+    } else if ((size_t)length < buffer->capacity - buffer->length) {
+      buffer->length += (size_t)length;
+      return;
+    }
+  }
+
+  buffer->is_failed = true;
+}
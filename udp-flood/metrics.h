@@ -0,0 +1,7 @@
+#pragma once
+
+#include <uv.h>
+
+// address is [host:]port, [ipv6]:port or unix:<path>, the host is 127.0.0.1 if it is omitted
+extern int metrics_start(uv_loop_t *loop, const char *address);
+extern void metrics_stop(void);
@@ -0,0 +1,64 @@
+#include "./pacer.h"
+#include "./atomic.h"
+#include <assert.h>
+#include <uv.h>
+
+#if defined(PLATFORM_LINUX)
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#endif /*PLATFORM_LINUX*/
+
+void pacer_spin_until(uint64_t due_ns) {
+  while (uv_hrtime() < due_ns) {
+    custom_atomic_cpu_relax();
+  }
+}
+
+#if defined(PLATFORM_LINUX)
+
+int pacer_timer_init(int *fd) {
+  assert(NULL != fd);
+
+  *fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (*fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+void pacer_timer_term(int fd) {
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+int pacer_timer_arm(int fd, uint64_t due_ns) {
+  assert(fd >= 0);
+
+  // zero disarms the timer, the earliest deadline is used instead
+  struct itimerspec spec = {{0, 0}, {0, 0}};
+  spec.it_value.tv_sec = (time_t)(due_ns / 1000000000);
+  spec.it_value.tv_nsec = (long)(due_ns % 1000000000);
+  if (0 == due_ns) {
+    spec.it_value.tv_nsec = 1;
+  }
+
+  if (0 != timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL)) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+void pacer_timer_clear(int fd) {
+  assert(fd >= 0);
+
+  uint64_t expirations = 0;
+  while (read(fd, &expirations, sizeof(expirations)) < 0 && EINTR == errno) {
+  }
+}
+
+#endif /*PLATFORM_LINUX*/
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "./platform.h"
+#include <stdint.h>
+
+// the OS wakes up a thread a few microseconds late, so the last part of every wait is spun
+#define PACER_SPIN_NS (20 * 1000)
+
+// a worker that was late for longer skips the missed sends instead of sending them at once
+#define PACER_MAXIMAL_LAG_NS (1000 * 1000)
+
+extern void pacer_spin_until(uint64_t due_ns);
+
+#if defined(PLATFORM_LINUX)
+
+// timerfd with absolute deadlines, it uses CLOCK_MONOTONIC like uv_hrtime
+extern int pacer_timer_init(int *fd);
+extern void pacer_timer_term(int fd);
+extern int pacer_timer_arm(int fd, uint64_t due_ns);
+extern void pacer_timer_clear(int fd);
+
+#endif /*PLATFORM_LINUX*/
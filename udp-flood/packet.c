@@ -0,0 +1,374 @@
+#include "./packet.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <ifaddrs.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <uv.h>
+
+// the kernel and the application hand frames over through the status word
+#define packet_load_acquire(_ptr) __atomic_load_n((_ptr), __ATOMIC_ACQUIRE)
+#define packet_store_release(_ptr, _value) __atomic_store_n((_ptr), (_value), __ATOMIC_RELEASE)
+
+// TPACKET_V2 transmits the data which follows the aligned frame header
+#define PACKET_DATA_OFFSET TPACKET_ALIGN(sizeof(struct tpacket2_hdr))
+
+#define PACKET_UDP_OFFSET(_is_ipv4) (PACKET_ETHER_HEADER_SIZE + ((_is_ipv4) ? sizeof(struct iphdr) : sizeof(struct ip6_hdr)))
+
+static uint16_t packet_checksum_finish(uint32_t sum);
+
+int packet_interface_query(packet_interface_t *iface, const char *name, bool is_ipv4) {
+  assert(NULL != iface);
+  assert(NULL != name);
+
+  memset(iface, 0, sizeof(*iface));
+
+  if (strlen(name) >= IFNAMSIZ) {
+    return UV_ENAMETOOLONG;
+  }
+
+  iface->index = (int)if_nametoindex(name);
+  if (0 == iface->index) {
+    return uv_translate_sys_error(errno);
+  }
+
+  int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  struct ifreq request;
+  memset(&request, 0, sizeof(request));
+  strcpy(request.ifr_name, name);
+
+  if (0 != ioctl(fd, SIOCGIFHWADDR, &request)) {
+    int err = uv_translate_sys_error(errno);
+    close(fd);
+    return err;
+  }
+
+  // loopback devices take Ethernet frames too, other link types do not
+  if (ARPHRD_ETHER != request.ifr_hwaddr.sa_family && ARPHRD_LOOPBACK != request.ifr_hwaddr.sa_family) {
+    close(fd);
+    return UV_ENOTSUP;
+  }
+
+  memcpy(iface->mac, request.ifr_hwaddr.sa_data, PACKET_MAC_SIZE);
+
+  if (0 != ioctl(fd, SIOCGIFMTU, &request)) {
+    int err = uv_translate_sys_error(errno);
+    close(fd);
+    return err;
+  }
+
+  iface->mtu = (unsigned int)request.ifr_mtu;
+
+  close(fd);
+
+  struct ifaddrs *addresses = NULL;
+  if (0 != getifaddrs(&addresses)) {
+    return uv_translate_sys_error(errno);
+  }
+
+  // a link-local IPv6 address is used only if the interface has no other one
+  bool found = false;
+  struct ifaddrs *entry = NULL;
+  for (entry = addresses; NULL != entry; entry = entry->ifa_next) {
+    if (NULL == entry->ifa_addr || 0 != strcmp(entry->ifa_name, name)) {
+      continue;
+    }
+
+    if (is_ipv4 && AF_INET == entry->ifa_addr->sa_family) {
+      memcpy(&iface->address.addr4, entry->ifa_addr, sizeof(iface->address.addr4));
+      found = true;
+      break;
+    } else if (!is_ipv4 && AF_INET6 == entry->ifa_addr->sa_family) {
+      memcpy(&iface->address.addr6, entry->ifa_addr, sizeof(iface->address.addr6));
+      found = true;
+      if (!IN6_IS_ADDR_LINKLOCAL(&iface->address.addr6.sin6_addr)) {
+        break;
+      }
+    }
+  }
+
+  freeifaddrs(addresses);
+
+  if (!found) {
+    return UV_EADDRNOTAVAIL;
+  }
+
+  return 0;
+}
+
+int packet_ring_init(packet_ring_t *ring, const packet_interface_t *iface, unsigned int frames_count,
+                     size_t frame_max_size) {
+  assert(NULL != ring);
+  assert(NULL != iface);
+  assert(0 != frames_count);
+
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+
+  // the protocol is zero, so the socket never receives anything
+  int fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  ring->fd = fd;
+
+  int version = TPACKET_V2;
+  if (0 != setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version))) {
+    int err = uv_translate_sys_error(errno);
+    packet_ring_term(ring);
+    return err;
+  }
+
+  // malformed frames are skipped instead of stopping the ring, the queueing discipline is bypassed if possible
+  int enabled = 1;
+  setsockopt(fd, SOL_PACKET, PACKET_LOSS, &enabled, sizeof(enabled));
+  setsockopt(fd, SOL_PACKET, PACKET_QDISC_BYPASS, &enabled, sizeof(enabled));
+
+  // frames are a power of two, so every block holds a whole number of them
+  unsigned int frame_size = TPACKET_ALIGNMENT;
+  while (frame_size < PACKET_DATA_OFFSET + frame_max_size) {
+    frame_size <<= 1;
+  }
+
+  unsigned int block_size = (unsigned int)sysconf(_SC_PAGESIZE);
+  if (block_size < frame_size) {
+    block_size = frame_size;
+  }
+
+  unsigned int frames_per_block = block_size / frame_size;
+
+  struct tpacket_req request;
+  memset(&request, 0, sizeof(request));
+  request.tp_block_size = block_size;
+  request.tp_block_nr = (frames_count + frames_per_block - 1) / frames_per_block;
+  request.tp_frame_size = frame_size;
+  request.tp_frame_nr = request.tp_block_nr * frames_per_block;
+
+  if (0 != setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &request, sizeof(request))) {
+    int err = uv_translate_sys_error(errno);
+    packet_ring_term(ring);
+    return err;
+  }
+
+  ring->frame_size = frame_size;
+  ring->frames_count = request.tp_frame_nr;
+  ring->map_size = (size_t)request.tp_block_size * request.tp_block_nr;
+
+  ring->map = (uint8_t *)mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+  if (MAP_FAILED == ring->map) {
+    int err = uv_translate_sys_error(errno);
+    ring->map = NULL;
+    packet_ring_term(ring);
+    return err;
+  }
+
+  struct sockaddr_ll link;
+  memset(&link, 0, sizeof(link));
+  link.sll_family = AF_PACKET;
+  // the protocol stays zero, a bound protocol would queue every inbound frame of the interface to this socket,
+  // the kernel takes the protocol of sent frames from their Ethernet headers
+  link.sll_protocol = 0;
+  link.sll_ifindex = iface->index;
+
+  if (0 != bind(fd, (const struct sockaddr *)&link, sizeof(link))) {
+    int err = uv_translate_sys_error(errno);
+    packet_ring_term(ring);
+    return err;
+  }
+
+  return 0;
+}
+
+void packet_ring_term(packet_ring_t *ring) {
+  assert(NULL != ring);
+
+  if (NULL != ring->map) {
+    munmap(ring->map, ring->map_size);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+uint8_t *packet_ring_frame(packet_ring_t *ring, unsigned int index) {
+  assert(NULL != ring);
+  assert(index < ring->frames_count);
+
+  return ring->map + (size_t)index * ring->frame_size + PACKET_DATA_OFFSET;
+}
+
+uint8_t *packet_ring_next(packet_ring_t *ring) {
+  assert(NULL != ring);
+
+  struct tpacket2_hdr *header = (struct tpacket2_hdr *)(ring->map + (size_t)ring->head * ring->frame_size);
+
+  uint32_t status = packet_load_acquire(&header->tp_status);
+  if (TP_STATUS_AVAILABLE != status && TP_STATUS_WRONG_FORMAT != status) {
+    return NULL;
+  }
+
+  return (uint8_t *)header + PACKET_DATA_OFFSET;
+}
+
+void packet_ring_commit(packet_ring_t *ring, size_t frame_size) {
+  assert(NULL != ring);
+
+  struct tpacket2_hdr *header = (struct tpacket2_hdr *)(ring->map + (size_t)ring->head * ring->frame_size);
+
+  header->tp_len = (uint32_t)frame_size;
+  packet_store_release(&header->tp_status, TP_STATUS_SEND_REQUEST);
+
+  ring->head = (ring->head + 1) % ring->frames_count;
+}
+
+int packet_ring_flush(packet_ring_t *ring) {
+  assert(NULL != ring);
+
+  // the kernel sends all requested frames and returns without waiting for their completion
+  ssize_t sent = 0;
+  do {
+    sent = send(ring->fd, NULL, 0, MSG_DONTWAIT);
+  } while (sent < 0 && EINTR == errno);
+
+  if (sent < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+size_t packet_headers_size(bool is_ipv4) {
+  return PACKET_UDP_OFFSET(is_ipv4) + sizeof(struct udphdr);
+}
+
+void packet_build_headers(uint8_t *frame, const uint8_t *source_mac, const uint8_t *destination_mac,
+                          const sockaddr_any *source) {
+  assert(NULL != frame);
+  assert(NULL != source_mac);
+  assert(NULL != destination_mac);
+  assert(NULL != source);
+
+  bool is_ipv4 = AF_INET == source->addr.sa_family;
+
+  struct ether_header ether;
+  memcpy(ether.ether_dhost, destination_mac, PACKET_MAC_SIZE);
+  memcpy(ether.ether_shost, source_mac, PACKET_MAC_SIZE);
+  ether.ether_type = htons(is_ipv4 ? ETHERTYPE_IP : ETHERTYPE_IPV6);
+  memcpy(frame, &ether, sizeof(ether));
+
+  if (is_ipv4) {
+    struct iphdr ip;
+    memset(&ip, 0, sizeof(ip));
+    ip.version = 4;
+    ip.ihl = sizeof(ip) / 4;
+    ip.frag_off = htons(IP_DF);
+    ip.ttl = 64;
+    ip.protocol = IPPROTO_UDP;
+    ip.saddr = source->addr4.sin_addr.s_addr;
+    memcpy(frame + PACKET_ETHER_HEADER_SIZE, &ip, sizeof(ip));
+  } else {
+    struct ip6_hdr ip;
+    memset(&ip, 0, sizeof(ip));
+    ip.ip6_flow = htonl(6 << 28);
+    ip.ip6_nxt = IPPROTO_UDP;
+    ip.ip6_hlim = 64;
+    ip.ip6_src = source->addr6.sin6_addr;
+    memcpy(frame + PACKET_ETHER_HEADER_SIZE, &ip, sizeof(ip));
+  }
+
+  struct udphdr udp;
+  memset(&udp, 0, sizeof(udp));
+  udp.uh_sport = is_ipv4 ? source->addr4.sin_port : source->addr6.sin6_port;
+  memcpy(frame + PACKET_UDP_OFFSET(is_ipv4), &udp, sizeof(udp));
+}
+
+size_t packet_patch_headers(uint8_t *frame, const sockaddr_any *destination, size_t payload_size,
+                            uint32_t payload_sum) {
+  assert(NULL != frame);
+  assert(NULL != destination);
+
+  bool is_ipv4 = AF_INET == destination->addr.sa_family;
+  uint8_t *ip_header = frame + PACKET_ETHER_HEADER_SIZE;
+  uint8_t *udp_header = frame + PACKET_UDP_OFFSET(is_ipv4);
+  uint16_t udp_size = (uint16_t)(sizeof(struct udphdr) + payload_size);
+
+  // the pseudo header contains the addresses, the protocol and the UDP length
+  uint32_t sum = payload_sum + IPPROTO_UDP + udp_size;
+
+  if (is_ipv4) {
+    struct iphdr *ip = (struct iphdr *)ip_header;
+    ip->tot_len = htons((uint16_t)(sizeof(struct iphdr) + udp_size));
+    memcpy(&ip->daddr, &destination->addr4.sin_addr, sizeof(ip->daddr));
+    ip->check = 0;
+    ip->check = packet_checksum_finish(packet_checksum_add(0, ip_header, sizeof(struct iphdr)));
+
+    sum = packet_checksum_add(sum, (const uint8_t *)&ip->saddr, 2 * sizeof(ip->saddr));
+  } else {
+    struct ip6_hdr *ip = (struct ip6_hdr *)ip_header;
+    ip->ip6_plen = htons(udp_size);
+    memcpy(&ip->ip6_dst, &destination->addr6.sin6_addr, sizeof(ip->ip6_dst));
+
+    sum = packet_checksum_add(sum, (const uint8_t *)&ip->ip6_src, 2 * sizeof(ip->ip6_src));
+  }
+
+  struct udphdr *udp = (struct udphdr *)udp_header;
+  udp->uh_dport = is_ipv4 ? destination->addr4.sin_port : destination->addr6.sin6_port;
+  udp->uh_ulen = htons(udp_size);
+  udp->uh_sum = 0;
+
+  // zero means that there is no checksum, so a computed zero is sent as all ones
+  uint16_t checksum = packet_checksum_finish(packet_checksum_add(sum, udp_header, sizeof(struct udphdr)));
+  udp->uh_sum = (0 == checksum) ? 0xffff : checksum;
+
+  return PACKET_UDP_OFFSET(is_ipv4) + udp_size;
+}
+
+uint32_t packet_checksum_add(uint32_t sum, const uint8_t *data, size_t size) {
+  assert(NULL != data || 0 == size);
+
+  uint64_t total = sum;
+  for (; size > 1; size -= 2, data += 2) {
+    total += ((uint32_t)data[0] << 8) | data[1];
+  }
+  if (size) {
+    total += (uint32_t)data[0] << 8;
+  }
+
+  while (total >> 16) {
+    total = (total & 0xffff) + (total >> 16);
+  }
+
+  return (uint32_t)total;
+}
+
+static uint16_t packet_checksum_finish(uint32_t sum) {
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+
+  return htons((uint16_t)~sum);
+}
+
+#endif /*PLATFORM_LINUX*/
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "./platform.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include "./address.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACKET_MAC_SIZE 6
+#define PACKET_ETHER_HEADER_SIZE 14
+
+typedef struct _packet_interface_t {
+  int index;
+  unsigned int mtu;
+  uint8_t mac[PACKET_MAC_SIZE];
+  // source address of the frames, the port is chosen by the caller
+  sockaddr_any address;
+} packet_interface_t;
+
+typedef struct _packet_ring_t {
+  int fd;
+  uint8_t *map;
+  size_t map_size;
+  unsigned int frame_size;
+  unsigned int frames_count;
+  // next frame to fill, the kernel sends frames in the same order
+  unsigned int head;
+} packet_ring_t;
+
+extern int packet_interface_query(packet_interface_t *iface, const char *name, bool is_ipv4);
+
+extern int packet_ring_init(packet_ring_t *ring, const packet_interface_t *iface, unsigned int frames_count,
+                            size_t frame_max_size);
+extern void packet_ring_term(packet_ring_t *ring);
+
+extern uint8_t *packet_ring_frame(packet_ring_t *ring, unsigned int index);
+extern uint8_t *packet_ring_next(packet_ring_t *ring);
+extern void packet_ring_commit(packet_ring_t *ring, size_t frame_size);
+extern int packet_ring_flush(packet_ring_t *ring);
+
+extern size_t packet_headers_size(bool is_ipv4);
+extern void packet_build_headers(uint8_t *frame, const uint8_t *source_mac, const uint8_t *destination_mac,
+                                 const sockaddr_any *source);
+extern size_t packet_patch_headers(uint8_t *frame, const sockaddr_any *destination, size_t payload_size,
+                                   uint32_t payload_sum);
+
+extern uint32_t packet_checksum_add(uint32_t sum, const uint8_t *data, size_t size);
+
+#endif /*PLATFORM_LINUX*/
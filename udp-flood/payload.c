@@ -0,0 +1,54 @@
+#include "./payload.h"
+#include "./random.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+int payload_pool_init(payload_pool_t *pool, size_t size) {
+  assert(NULL != pool);
+  assert(0 != size);
+
+  memset(pool, 0, sizeof(*pool));
+
+  pool->data = (uint8_t *)malloc(size);
+  if (NULL == pool->data) {
+    return UV_ENOMEM;
+  }
+
+  pool->size = size;
+  random_fill(pool->data, pool->size);
+
+  return 0;
+}
+
+void payload_pool_term(payload_pool_t *pool) {
+  assert(NULL != pool);
+
+  free(pool->data);
+  memset(pool, 0, sizeof(*pool));
+}
+
+uint8_t *payload_pool_slice(payload_pool_t *pool, size_t size) {
+  assert(NULL != pool);
+  assert(size <= pool->size);
+
+  size_t offset = random_next() % (pool->size - size + 1);
+  return pool->data + offset;
+}
+
+void payload_pool_refresh(payload_pool_t *pool, size_t size) {
+  assert(NULL != pool);
+
+  while (size > 0) {
+    size_t length = pool->size - pool->refresh_position;
+    if (length > size) {
+      length = size;
+    }
+
+    random_fill(pool->data + pool->refresh_position, length);
+
+    size -= length;
+    pool->refresh_position = (pool->refresh_position + length) % pool->size;
+  }
+}
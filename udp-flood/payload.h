@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// random bytes shared by all datagrams of one worker, datagrams are slices at random offsets
+typedef struct _payload_pool_t {
+  uint8_t *data;
+  size_t size;
+  // next byte to regenerate, refreshing walks through the pool
+  size_t refresh_position;
+} payload_pool_t;
+
+extern int payload_pool_init(payload_pool_t *pool, size_t size);
+extern void payload_pool_term(payload_pool_t *pool);
+
+extern uint8_t *payload_pool_slice(payload_pool_t *pool, size_t size);
+extern void payload_pool_refresh(payload_pool_t *pool, size_t size);
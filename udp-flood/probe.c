@@ -0,0 +1,223 @@
+#include "./probe.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+static void probe_put32(uint8_t *buffer, uint32_t value);
+static void probe_put64(uint8_t *buffer, uint64_t value);
+static uint32_t probe_get32(const uint8_t *buffer);
+static uint64_t probe_get64(const uint8_t *buffer);
+
+static size_t probe_flow_hash(const sockaddr_any *source, uint32_t worker);
+static bool probe_flow_matches(const probe_flow_t *flow, const sockaddr_any *source, uint32_t worker);
+static void probe_flow_advance(probe_flow_t *flow, uint64_t sequence);
+
+void probe_write(uint8_t *buffer, uint32_t worker, uint64_t sequence, uint64_t time_ns) {
+  assert(NULL != buffer);
+
+  probe_put32(buffer, PROBE_MAGIC);
+  probe_put32(buffer + 4, worker);
+  probe_put64(buffer + 8, sequence);
+  probe_put64(buffer + 16, time_ns);
+}
+
+bool probe_read(const uint8_t *buffer, size_t size, probe_header_t *header) {
+  assert(NULL != buffer);
+  assert(NULL != header);
+
+  if (size < PROBE_HEADER_SIZE || PROBE_MAGIC != probe_get32(buffer)) {
+    return false;
+  }
+
+  header->worker = probe_get32(buffer + 4);
+  header->sequence = probe_get64(buffer + 8);
+  header->time_ns = probe_get64(buffer + 16);
+
+  return true;
+}
+
+int probe_flows_init(probe_flows_t *flows) {
+  assert(NULL != flows);
+
+  memset(flows, 0, sizeof(*flows));
+
+  flows->flows = (probe_flow_t *)calloc(PROBE_FLOWS_CAPACITY, sizeof(*flows->flows));
+  if (NULL == flows->flows) {
+    return UV_ENOMEM;
+  }
+
+  return 0;
+}
+
+void probe_flows_term(probe_flows_t *flows) {
+  assert(NULL != flows);
+
+  free(flows->flows);
+  memset(flows, 0, sizeof(*flows));
+}
+
+probe_flow_t *probe_flows_record(probe_flows_t *flows, const sockaddr_any *source, const probe_header_t *header,
+                                 uint64_t time_ns) {
+  assert(NULL != flows);
+  assert(NULL != flows->flows);
+  assert(NULL != source);
+  assert(NULL != header);
+
+  // open addressing, flows are never removed, so the first free entry ends the search
+  size_t start = probe_flow_hash(source, header->worker);
+  probe_flow_t *flow = NULL;
+
+  size_t attempt = 0;
+  for (attempt = 0; attempt < PROBE_FLOWS_CAPACITY; ++attempt) {
+    probe_flow_t *candidate = &flows->flows[(start + attempt) % PROBE_FLOWS_CAPACITY];
+    if (!candidate->is_used || probe_flow_matches(candidate, source, header->worker)) {
+      flow = candidate;
+      break;
+    }
+  }
+
+  if (NULL == flow) {
+    ++flows->untracked;
+    return NULL;
+  }
+
+  uint64_t sequence = header->sequence;
+  uint64_t missing = 0;
+
+  if (!flow->is_used) {
+    flow->is_used = true;
+    flow->source = *source;
+    flow->worker = header->worker;
+    flow->first = sequence;
+    flow->highest = sequence;
+    flow->window[(sequence % PROBE_WINDOW) / 64] |= 1ULL << (sequence % 64);
+    flow->received = 1;
+    flow->latency_minimum = UINT64_MAX;
+    ++flows->count;
+  } else {
+    missing = probe_flow_missing(flow);
+
+    uint64_t depth = (flow->highest > sequence) ? flow->highest - sequence : 0;
+    uint64_t *word = &flow->window[(sequence % PROBE_WINDOW) / 64];
+    uint64_t bit = 1ULL << (sequence % 64);
+
+    if (sequence > flow->highest) {
+      probe_flow_advance(flow, sequence);
+      ++flow->received;
+    } else if (sequence < flow->first) {
+      // the datagram was sent before the first received one, it is outside of the counted range
+      ++flow->late;
+      ++flow->reordered;
+      ++flows->reordered;
+    } else if (depth >= PROBE_WINDOW) {
+      // the window does not remember it, so a duplicate is taken for a late datagram
+      ++flow->late;
+      ++flow->received;
+      ++flow->reordered;
+      ++flows->reordered;
+    } else if (*word & bit) {
+      ++flow->duplicates;
+      ++flows->duplicates;
+    } else {
+      *word |= bit;
+      ++flow->received;
+      ++flow->reordered;
+      ++flows->reordered;
+    }
+
+    if (depth > flow->reorder_depth) {
+      flow->reorder_depth = depth;
+    }
+  }
+
+  flows->missing = flows->missing - missing + probe_flow_missing(flow);
+
+  // the clocks of the sender and the receiver are the same only on one host
+  uint64_t latency = (time_ns > header->time_ns) ? time_ns - header->time_ns : 0;
+  ++flow->latency_count;
+  flow->latency_sum += latency;
+  if (latency < flow->latency_minimum) {
+    flow->latency_minimum = latency;
+  }
+  if (latency > flow->latency_maximum) {
+    flow->latency_maximum = latency;
+  }
+
+  return flow;
+}
+
+uint64_t probe_flow_missing(const probe_flow_t *flow) {
+  assert(NULL != flow);
+
+  uint64_t expected = flow->highest - flow->first + 1;
+  return (expected > flow->received) ? expected - flow->received : 0;
+}
+
+static void probe_put32(uint8_t *buffer, uint32_t value) {
+  buffer[0] = (uint8_t)(value >> 24);
+  buffer[1] = (uint8_t)(value >> 16);
+  buffer[2] = (uint8_t)(value >> 8);
+  buffer[3] = (uint8_t)value;
+}
+
+static void probe_put64(uint8_t *buffer, uint64_t value) {
+  probe_put32(buffer, (uint32_t)(value >> 32));
+  probe_put32(buffer + 4, (uint32_t)value);
+}
+
+static uint32_t probe_get32(const uint8_t *buffer) {
+  return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | (uint32_t)buffer[3];
+}
+
+static uint64_t probe_get64(const uint8_t *buffer) {
+  return ((uint64_t)probe_get32(buffer) << 32) | (uint64_t)probe_get32(buffer + 4);
+}
+
+static size_t probe_flow_hash(const sockaddr_any *source, uint32_t worker) {
+  const uint8_t *address = NULL;
+  size_t address_size = 0;
+  uint16_t port = 0;
+
+  if (AF_INET == source->addr.sa_family) {
+    address = (const uint8_t *)&source->addr4.sin_addr;
+    address_size = sizeof(source->addr4.sin_addr);
+    port = source->addr4.sin_port;
+  } else {
+    address = (const uint8_t *)&source->addr6.sin6_addr;
+    address_size = sizeof(source->addr6.sin6_addr);
+    port = source->addr6.sin6_port;
+  }
+
+  // FNV-1a of the address, the port and the worker
+  uint32_t hash = 2166136261u;
+
+  size_t index = 0;
+  for (index = 0; index < address_size; ++index) {
+    hash = (hash ^ address[index]) * 16777619u;
+  }
+
+  hash = (hash ^ (uint32_t)port) * 16777619u;
+  hash = (hash ^ worker) * 16777619u;
+
+  return (size_t)hash;
+}
+
+static bool probe_flow_matches(const probe_flow_t *flow, const sockaddr_any *source, uint32_t worker) {
+  return flow->worker == worker && address_equal(&flow->source, source);
+}
+
+static void probe_flow_advance(probe_flow_t *flow, uint64_t sequence) {
+  // bits of the skipped sequences are cleared, they are missing until they arrive
+  if (sequence - flow->highest >= PROBE_WINDOW) {
+    memset(flow->window, 0, sizeof(flow->window));
+  } else {
+    uint64_t skipped = 0;
+    for (skipped = flow->highest + 1; skipped < sequence; ++skipped) {
+      flow->window[(skipped % PROBE_WINDOW) / 64] &= ~(1ULL << (skipped % 64));
+    }
+  }
+
+  flow->window[(sequence % PROBE_WINDOW) / 64] |= 1ULL << (sequence % 64);
+  flow->highest = sequence;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "./address.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// magic, worker, sequence and send time, all of them in network byte order
+#define PROBE_HEADER_SIZE 24
+#define PROBE_MAGIC 0x55464c44
+
+// sequences behind the highest one which are remembered, older ones are late and counted as received
+#define PROBE_WINDOW 1024
+
+// flows tracked by one receiver, datagrams of other flows are only counted
+#define PROBE_FLOWS_CAPACITY 1024
+
+typedef struct _probe_header_t {
+  uint32_t worker;
+  uint64_t sequence;
+  uint64_t time_ns;
+} probe_header_t;
+
+// a flow is a worker of a sender, the source address tells the senders apart
+typedef struct _probe_flow_t {
+  bool is_used;
+  sockaddr_any source;
+  uint32_t worker;
+
+  uint64_t first;
+  uint64_t highest;
+  // bit of each sequence of (highest - PROBE_WINDOW, highest] which was received
+  uint64_t window[PROBE_WINDOW / 64];
+
+  uint64_t received;
+  uint64_t reordered;
+  uint64_t reorder_depth;
+  uint64_t duplicates;
+  uint64_t late;
+
+  // nanoseconds from the send time of the header to the reception
+  uint64_t latency_count;
+  uint64_t latency_sum;
+  uint64_t latency_minimum;
+  uint64_t latency_maximum;
+} probe_flow_t;
+
+typedef struct _probe_flows_t {
+  probe_flow_t *flows;
+  size_t count;
+
+  // sums of all flows, missing datagrams are a level and could decrease when late ones arrive
+  uint64_t missing;
+  uint64_t reordered;
+  uint64_t duplicates;
+  uint64_t untracked;
+} probe_flows_t;
+
+extern void probe_write(uint8_t *buffer, uint32_t worker, uint64_t sequence, uint64_t time_ns);
+extern bool probe_read(const uint8_t *buffer, size_t size, probe_header_t *header);
+
+extern int probe_flows_init(probe_flows_t *flows);
+extern void probe_flows_term(probe_flows_t *flows);
+
+// returns NULL if the table is full and the flow is not tracked
+extern probe_flow_t *probe_flows_record(probe_flows_t *flows, const sockaddr_any *source, const probe_header_t *header,
+                                        uint64_t time_ns);
+
+extern uint64_t probe_flow_missing(const probe_flow_t *flow);
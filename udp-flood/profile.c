@@ -0,0 +1,209 @@
+#include "./profile.h"
+#include "./random.h"
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uv.h>
+
+// IPv4 frames have 14 bytes of Ethernet header, 4 bytes of FCS, 20 bytes of IP header and 8 bytes of UDP header
+#define PROFILE_IMIX_OVERHEAD 46
+
+#define PROFILE_LINE_SIZE 256
+
+void profile_init(profile_t *profile) {
+  assert(NULL != profile);
+
+  memset(profile, 0, sizeof(*profile));
+}
+
+int profile_add(profile_t *profile, int size, double weight) {
+  assert(NULL != profile);
+
+  if (profile->count >= PROFILE_MAXIMAL_ENTRIES) {
+    return UV_E2BIG;
+  } else if (!(weight >= 0.0)) {
+    return UV_EINVAL;
+  }
+
+  profile->sizes[profile->count] = size;
+  profile->weights[profile->count] = weight;
+  ++profile->count;
+
+  return 0;
+}
+
+int profile_add_imix(profile_t *profile, int minimal_size) {
+  assert(NULL != profile);
+
+  static const int frames[] = {64, 594, 1518};
+  static const double weights[] = {7.0, 4.0, 1.0};
+
+  size_t index = 0;
+  for (index = 0; index < sizeof(frames) / sizeof(frames[0]); ++index) {
+    int size = frames[index] - PROFILE_IMIX_OVERHEAD;
+    int err = profile_add(profile, (size > minimal_size) ? size : minimal_size, weights[index]);
+    if (err) {
+      return err;
+    }
+  }
+
+  return 0;
+}
+
+int profile_load(profile_t *profile, const char *path, unsigned int *error_line) {
+  assert(NULL != profile);
+  assert(NULL != path);
+  assert(NULL != error_line);
+
+  *error_line = 0;
+
+  FILE *file = NULL;
+  int err = fopen_s(&file, path, "r");
+  if (err || NULL == file) {
+    return uv_translate_sys_error(err ? err : EINVAL);
+  }
+
+  char line[PROFILE_LINE_SIZE] = {0};
+  unsigned int line_number = 0;
+  while (NULL != fgets(line, sizeof(line), file)) {
+    ++line_number;
+
+    const char *cursor = line;
+    while (isspace((unsigned char)*cursor)) {
+      ++cursor;
+    }
+
+    if (0 == *cursor || '#' == *cursor) {
+      continue;
+    }
+
+    char *end = NULL;
+    long size = strtol(cursor, &end, 10);
+    if (end == cursor || size <= 0 || size > INT32_MAX) {
+      err = UV_EINVAL;
+      break;
+    }
+
+    cursor = end;
+    double weight = strtod(cursor, &end);
+    if (end == cursor) {
+      err = UV_EINVAL;
+      break;
+    }
+
+    for (cursor = end; isspace((unsigned char)*cursor); ++cursor) {
+    }
+
+    if (0 != *cursor && '#' != *cursor) {
+      err = UV_EINVAL;
+      break;
+    }
+
+    err = profile_add(profile, (int)size, weight);
+    if (err) {
+      break;
+    }
+  }
+
+  fclose(file);
+
+  if (err) {
+    *error_line = line_number;
+  }
+
+  return err;
+}
+
+int profile_build(profile_t *profile) {
+  assert(NULL != profile);
+
+  double total = 0.0;
+  unsigned int index = 0;
+  for (index = 0; index < profile->count; ++index) {
+    total += profile->weights[index];
+  }
+
+  if (0 == profile->count || !(total > 0.0)) {
+    return UV_EINVAL;
+  }
+
+  profile->size_min = profile->sizes[0];
+  profile->size_max = profile->sizes[0];
+  profile->mean = 0.0;
+
+  // Vose's method, every entry gets the probability count * weight / total and small entries borrow from large ones
+  double scaled[PROFILE_MAXIMAL_ENTRIES];
+  unsigned int small[PROFILE_MAXIMAL_ENTRIES];
+  unsigned int large[PROFILE_MAXIMAL_ENTRIES];
+  unsigned int small_count = 0;
+  unsigned int large_count = 0;
+
+  for (index = 0; index < profile->count; ++index) {
+    int size = profile->sizes[index];
+    profile->size_min = (size < profile->size_min) ? size : profile->size_min;
+    profile->size_max = (size > profile->size_max) ? size : profile->size_max;
+    profile->mean += size * profile->weights[index] / total;
+
+    scaled[index] = profile->weights[index] * profile->count / total;
+    profile->aliases[index] = index;
+
+    if (scaled[index] < 1.0) {
+      small[small_count++] = index;
+    } else {
+      large[large_count++] = index;
+    }
+  }
+
+  while (small_count > 0 && large_count > 0) {
+    unsigned int lower = small[--small_count];
+    unsigned int upper = large[--large_count];
+
+    profile->thresholds[lower] = (uint64_t)(scaled[lower] * 4294967296.0);
+    profile->aliases[lower] = upper;
+
+    scaled[upper] -= 1.0 - scaled[lower];
+    if (scaled[upper] < 1.0) {
+      small[small_count++] = upper;
+    } else {
+      large[large_count++] = upper;
+    }
+  }
+
+  // the rest is 1.0 up to rounding errors
+  while (large_count > 0) {
+    profile->thresholds[large[--large_count]] = 4294967296ull;
+  }
+  while (small_count > 0) {
+    profile->thresholds[small[--small_count]] = 4294967296ull;
+  }
+
+  return 0;
+}
+
+unsigned int profile_next(const profile_t *profile) {
+  assert(NULL != profile);
+  assert(0 != profile->count);
+
+  unsigned int index = random_next() % profile->count;
+  return ((uint64_t)random_next() < profile->thresholds[index]) ? index : profile->aliases[index];
+}
+
+double profile_mean(const profile_t *profile, const uint64_t *counts, uint64_t *count) {
+  assert(NULL != profile);
+  assert(NULL != counts);
+  assert(NULL != count);
+
+  double bytes = 0.0;
+  *count = 0;
+
+  unsigned int index = 0;
+  for (index = 0; index < profile->count; ++index) {
+    bytes += (double)counts[index] * profile->sizes[index];
+    *count += counts[index];
+  }
+
+  return (0 != *count) ? bytes / (double)*count : 0.0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILE_MAXIMAL_ENTRIES 256
+
+// weighted datagram sizes, a size is drawn in constant time with the alias method
+typedef struct _profile_t {
+  unsigned int count;
+  int sizes[PROFILE_MAXIMAL_ENTRIES];
+  double weights[PROFILE_MAXIMAL_ENTRIES];
+
+  // an entry is drawn uniformly, it keeps its own size if a random number is below its threshold
+  // and takes the size of its alias otherwise, thresholds are scaled to 2^32
+  uint64_t thresholds[PROFILE_MAXIMAL_ENTRIES];
+  unsigned int aliases[PROFILE_MAXIMAL_ENTRIES];
+
+  int size_min, size_max;
+  double mean;
+} profile_t;
+
+extern void profile_init(profile_t *profile);
+extern int profile_add(profile_t *profile, int size, double weight);
+
+// 7:4:1 of 64, 594 and 1518 byte Ethernet frames with IPv4, sizes below the minimal one are raised to it
+extern int profile_add_imix(profile_t *profile, int minimal_size);
+
+// every line has a size and a weight, empty lines and lines starting with '#' are skipped
+extern int profile_load(profile_t *profile, const char *path, unsigned int *error_line);
+
+// prepares the alias table, it fails if there are no entries or no positive weights
+extern int profile_build(profile_t *profile);
+
+// returns the index of the drawn entry
+extern unsigned int profile_next(const profile_t *profile);
+
+// mean size of datagrams counted for each entry, 0 if there are no datagrams
+extern double profile_mean(const profile_t *profile, const uint64_t *counts, uint64_t *count);
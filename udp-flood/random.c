@@ -1,17 +1,292 @@
 #include "./random.h"
-#include <stdint.h>
+#include "./platform.h"
+#include <stdbool.h>
+#include <string.h>
 #include <uv.h>
 
-static __declspec(thread) unsigned int s_u = 0, s_v = 0;
+#if defined(ARCHITECTURE_I386) || defined(ARCHITECTURE_AMD64)
+#if defined(COMPILER_MSVC)
+#include <intrin.h>
+#endif /*COMPILER_MSVC*/
+#include <immintrin.h>
+#define RANDOM_HAS_X86
+#elif defined(ARCHITECTURE_ARM) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RANDOM_HAS_NEON
+#endif
 
-unsigned int random(void) {
-  if (0 == s_v && 0 == s_u) {
-    s_v = (unsigned int)((uintptr_t)uv_os_getpid() * (uintptr_t)uv_thread_self());
-    s_u = (unsigned int)(uintptr_t)uv_hrtime();
+#if defined(COMPILER_GCC) || defined(COMPILER_CLANG) || defined(COMPILER_MINGW)
+#define RANDOM_TARGET(name) __attribute__((target(name)))
+#else
+#define RANDOM_TARGET(name)
+#endif
+
+// random_fill runs RANDOM_LANES generators side by side, one block has a 64-bit value of each lane
+#define RANDOM_LANES 4
+#define RANDOM_BLOCK_SIZE (RANDOM_LANES * sizeof(uint64_t))
+
+typedef void (*random_kernel_cb)(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks);
+
+typedef struct _random_state_t {
+  bool is_seeded;
+  uint64_t scalar[4];
+  // word-major state of the lanes, so one vector register keeps one word of every lane
+  uint64_t lanes[4][RANDOM_LANES];
+  random_kernel_cb kernel;
+} random_state_t;
+
+static thread_local random_state_t s_state;
+
+static uint64_t random_splitmix(uint64_t *x);
+static random_kernel_cb random_select_kernel(void);
+static void random_kernel_scalar(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks);
+#if defined(RANDOM_HAS_X86)
+static void random_kernel_sse2(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks);
+static void random_kernel_avx2(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks);
+static bool random_has_avx2(void);
+#elif defined(RANDOM_HAS_NEON)
+static void random_kernel_neon(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks);
+#endif
+
+static inline uint64_t random_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+void random_seed(uint64_t seed, uint64_t stream) {
+  uint64_t x = seed ^ (stream * 0xd1b54a32d192ed03ull);
+
+  size_t index = 0;
+  for (index = 0; index < 4; ++index) {
+    s_state.scalar[index] = random_splitmix(&x);
+  }
+
+  size_t lane = 0;
+  for (lane = 0; lane < RANDOM_LANES; ++lane) {
+    for (index = 0; index < 4; ++index) {
+      s_state.lanes[index][lane] = random_splitmix(&x);
+    }
+  }
+
+  s_state.kernel = random_select_kernel();
+  s_state.is_seeded = true;
+}
+
+unsigned int random_next(void) {
+  if (!s_state.is_seeded) {
+    random_seed(uv_hrtime(), (uint64_t)uv_os_getpid() * (uint64_t)(uintptr_t)uv_thread_self());
+  }
+
+  uint64_t *s = s_state.scalar;
+  uint64_t result = random_rotl(s[0] + s[3], 23) + s[0];
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = random_rotl(s[3], 45);
+
+  // upper bits are the best ones
+  return (unsigned int)(result >> 32);
+}
+
+void random_fill(void *data, size_t size) {
+  if (!s_state.is_seeded) {
+    random_seed(uv_hrtime(), (uint64_t)uv_os_getpid() * (uint64_t)(uintptr_t)uv_thread_self());
+  }
+
+  size_t blocks = size / RANDOM_BLOCK_SIZE;
+  s_state.kernel(s_state.lanes, (uint8_t *)data, blocks);
+
+  size_t tail = size - blocks * RANDOM_BLOCK_SIZE;
+  if (0 != tail) {
+    uint8_t block[RANDOM_BLOCK_SIZE];
+    s_state.kernel(s_state.lanes, block, 1);
+    memcpy((uint8_t *)data + blocks * RANDOM_BLOCK_SIZE, block, tail);
+  }
+}
+
+static uint64_t random_splitmix(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static random_kernel_cb random_select_kernel(void) {
+#if defined(RANDOM_HAS_X86)
+  if (random_has_avx2()) {
+    return random_kernel_avx2;
+  }
+#if defined(ARCHITECTURE_AMD64) || defined(__SSE2__)
+  return random_kernel_sse2;
+#endif
+#elif defined(RANDOM_HAS_NEON)
+  return random_kernel_neon;
+#endif
+  return random_kernel_scalar;
+}
+
+// all kernels give the same bytes, so a seed reproduces a run on any CPU
+
+static void random_kernel_scalar(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks) {
+  size_t block = 0;
+  for (block = 0; block < blocks; ++block) {
+    size_t lane = 0;
+    for (lane = 0; lane < RANDOM_LANES; ++lane) {
+      uint64_t result = random_rotl(lanes[0][lane] + lanes[3][lane], 23) + lanes[0][lane];
+      uint64_t t = lanes[1][lane] << 17;
+
+      lanes[2][lane] ^= lanes[0][lane];
+      lanes[3][lane] ^= lanes[1][lane];
+      lanes[1][lane] ^= lanes[2][lane];
+      lanes[0][lane] ^= lanes[3][lane];
+      lanes[2][lane] ^= t;
+      lanes[3][lane] = random_rotl(lanes[3][lane], 45);
+
+      // little endian on every platform, the bytes do not depend on the CPU
+      size_t index = 0;
+      for (index = 0; index < sizeof(result); ++index) {
+        data[block * RANDOM_BLOCK_SIZE + lane * sizeof(result) + index] = (uint8_t)(result >> (8 * index));
+      }
+    }
+  }
+}
+
+#if defined(RANDOM_HAS_X86)
+
+#define RANDOM_ROTL_SSE2(x, k) _mm_or_si128(_mm_slli_epi64((x), (k)), _mm_srli_epi64((x), 64 - (k)))
+
+RANDOM_TARGET("sse2")
+static void random_kernel_sse2(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks) {
+  // two registers per word, lanes 0-1 and lanes 2-3
+  __m128i s0[2], s1[2], s2[2], s3[2];
+
+  int half = 0;
+  for (half = 0; half < 2; ++half) {
+    s0[half] = _mm_loadu_si128((const __m128i *)&lanes[0][half * 2]);
+    s1[half] = _mm_loadu_si128((const __m128i *)&lanes[1][half * 2]);
+    s2[half] = _mm_loadu_si128((const __m128i *)&lanes[2][half * 2]);
+    s3[half] = _mm_loadu_si128((const __m128i *)&lanes[3][half * 2]);
+  }
+
+  size_t block = 0;
+  for (block = 0; block < blocks; ++block) {
+    for (half = 0; half < 2; ++half) {
+      __m128i result = _mm_add_epi64(RANDOM_ROTL_SSE2(_mm_add_epi64(s0[half], s3[half]), 23), s0[half]);
+      __m128i t = _mm_slli_epi64(s1[half], 17);
+
+      s2[half] = _mm_xor_si128(s2[half], s0[half]);
+      s3[half] = _mm_xor_si128(s3[half], s1[half]);
+      s1[half] = _mm_xor_si128(s1[half], s2[half]);
+      s0[half] = _mm_xor_si128(s0[half], s3[half]);
+      s2[half] = _mm_xor_si128(s2[half], t);
+      s3[half] = RANDOM_ROTL_SSE2(s3[half], 45);
+
+      _mm_storeu_si128((__m128i *)(data + block * RANDOM_BLOCK_SIZE + half * sizeof(__m128i)), result);
+    }
+  }
+
+  for (half = 0; half < 2; ++half) {
+    _mm_storeu_si128((__m128i *)&lanes[0][half * 2], s0[half]);
+    _mm_storeu_si128((__m128i *)&lanes[1][half * 2], s1[half]);
+    _mm_storeu_si128((__m128i *)&lanes[2][half * 2], s2[half]);
+    _mm_storeu_si128((__m128i *)&lanes[3][half * 2], s3[half]);
+  }
+}
+
+#define RANDOM_ROTL_AVX2(x, k) _mm256_or_si256(_mm256_slli_epi64((x), (k)), _mm256_srli_epi64((x), 64 - (k)))
+
+RANDOM_TARGET("avx2")
+static void random_kernel_avx2(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks) {
+  __m256i s0 = _mm256_loadu_si256((const __m256i *)lanes[0]);
+  __m256i s1 = _mm256_loadu_si256((const __m256i *)lanes[1]);
+  __m256i s2 = _mm256_loadu_si256((const __m256i *)lanes[2]);
+  __m256i s3 = _mm256_loadu_si256((const __m256i *)lanes[3]);
+
+  size_t block = 0;
+  for (block = 0; block < blocks; ++block) {
+    __m256i result = _mm256_add_epi64(RANDOM_ROTL_AVX2(_mm256_add_epi64(s0, s3), 23), s0);
+    __m256i t = _mm256_slli_epi64(s1, 17);
+
+    s2 = _mm256_xor_si256(s2, s0);
+    s3 = _mm256_xor_si256(s3, s1);
+    s1 = _mm256_xor_si256(s1, s2);
+    s0 = _mm256_xor_si256(s0, s3);
+    s2 = _mm256_xor_si256(s2, t);
+    s3 = RANDOM_ROTL_AVX2(s3, 45);
+
+    _mm256_storeu_si256((__m256i *)(data + block * RANDOM_BLOCK_SIZE), result);
   }
 
-  s_v = 36969 * (s_v & 65535) + (s_v >> 16);
-  s_u = 18000 * (s_u & 65535) + (s_u >> 16);
+  _mm256_storeu_si256((__m256i *)lanes[0], s0);
+  _mm256_storeu_si256((__m256i *)lanes[1], s1);
+  _mm256_storeu_si256((__m256i *)lanes[2], s2);
+  _mm256_storeu_si256((__m256i *)lanes[3], s3);
+}
+
+static bool random_has_avx2(void) {
+#if defined(COMPILER_MSVC)
+  int info[4] = {0};
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  // the OS should save YMM registers on context switches
+  __cpuid(info, 1);
+  if (0 == (info[2] & (1 << 27)) || 6 != (_xgetbv(0) & 6)) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return 0 != (info[1] & (1 << 5));
+#else  /*!COMPILER_MSVC*/
+  __builtin_cpu_init();
+  return 0 != __builtin_cpu_supports("avx2");
+#endif /*COMPILER_MSVC*/
+}
+
+#elif defined(RANDOM_HAS_NEON)
+
+#define RANDOM_ROTL_NEON(x, k) vorrq_u64(vshlq_n_u64((x), (k)), vshrq_n_u64((x), 64 - (k)))
 
-  return (s_v << 16) + (s_u & 65535);
+static void random_kernel_neon(uint64_t lanes[4][RANDOM_LANES], uint8_t *data, size_t blocks) {
+  // two registers per word, lanes 0-1 and lanes 2-3
+  uint64x2_t s0[2], s1[2], s2[2], s3[2];
+
+  int half = 0;
+  for (half = 0; half < 2; ++half) {
+    s0[half] = vld1q_u64(&lanes[0][half * 2]);
+    s1[half] = vld1q_u64(&lanes[1][half * 2]);
+    s2[half] = vld1q_u64(&lanes[2][half * 2]);
+    s3[half] = vld1q_u64(&lanes[3][half * 2]);
+  }
+
+  size_t block = 0;
+  for (block = 0; block < blocks; ++block) {
+    for (half = 0; half < 2; ++half) {
+      uint64x2_t result = vaddq_u64(RANDOM_ROTL_NEON(vaddq_u64(s0[half], s3[half]), 23), s0[half]);
+      uint64x2_t t = vshlq_n_u64(s1[half], 17);
+
+      s2[half] = veorq_u64(s2[half], s0[half]);
+      s3[half] = veorq_u64(s3[half], s1[half]);
+      s1[half] = veorq_u64(s1[half], s2[half]);
+      s0[half] = veorq_u64(s0[half], s3[half]);
+      s2[half] = veorq_u64(s2[half], t);
+      s3[half] = RANDOM_ROTL_NEON(s3[half], 45);
+
+      vst1q_u8(data + block * RANDOM_BLOCK_SIZE + half * sizeof(uint64x2_t), vreinterpretq_u8_u64(result));
+    }
+  }
+
+  for (half = 0; half < 2; ++half) {
+    vst1q_u64(&lanes[0][half * 2], s0[half]);
+    vst1q_u64(&lanes[1][half * 2], s1[half]);
+    vst1q_u64(&lanes[2][half * 2], s2[half]);
+    vst1q_u64(&lanes[3][half * 2], s3[half]);
+  }
 }
+
+#endif /*RANDOM_HAS_NEON*/
@@ -1,3 +1,12 @@
 #pragma once
 
-unsigned int random(void);
+#include <stddef.h>
+#include <stdint.h>
+
+// xoshiro256++ generator, each thread has its own state
+
+// the same seed and stream give the same sequence, streams of one seed are independent
+extern void random_seed(uint64_t seed, uint64_t stream);
+
+extern unsigned int random_next(void);
+extern void random_fill(void *data, size_t size);
@@ -0,0 +1,74 @@
+#include "./rate.h"
+#include <assert.h>
+
+// one chunk is earned in 100us, so workers touch the shared counter at most 10000 times per second in total
+#define RATE_CHUNKS_PER_SECOND 10000
+
+// credits that were not used for so long are dropped, otherwise a slow start would be followed by a burst
+#define RATE_MAXIMAL_LAG_NS (10 * 1000 * 1000)
+
+static uint64_t rate_bucket_time(const rate_bucket_t *bucket, size_t chunks);
+static size_t rate_bucket_chunks(const rate_bucket_t *bucket, uint64_t time_ns);
+
+void rate_bucket_init(rate_bucket_t *bucket, uint64_t rate, uint64_t start_ns) {
+  assert(NULL != bucket);
+
+  bucket->rate = rate;
+  bucket->chunk = rate / RATE_CHUNKS_PER_SECOND;
+  if (0 == bucket->chunk) {
+    bucket->chunk = 1;
+  }
+
+  bucket->start_ns = start_ns;
+  custom_atomic_init(&bucket->taken_chunks, 0);
+}
+
+bool rate_bucket_is_limited(const rate_bucket_t *bucket) {
+  assert(NULL != bucket);
+
+  return 0 != bucket->rate;
+}
+
+uint64_t rate_account_take(rate_account_t *account, rate_bucket_t *bucket, uint64_t used, uint64_t time_ns) {
+  assert(NULL != account);
+  assert(NULL != bucket);
+
+  if (!rate_bucket_is_limited(bucket) || used < account->taken) {
+    return account->due_ns;
+  }
+
+  // sends are counted after they are done, so the worker could owe more than one chunk
+  size_t count = (size_t)((used - account->taken) / bucket->chunk + 1);
+  size_t position = custom_atomic_fetch_add(&bucket->taken_chunks, count) + count;
+
+  uint64_t due_ns = rate_bucket_time(bucket, position);
+  if (due_ns + RATE_MAXIMAL_LAG_NS < time_ns) {
+    // the workers could not keep up with the rate, nobody should get the credits of the past at once
+    size_t earliest = rate_bucket_chunks(bucket, time_ns - RATE_MAXIMAL_LAG_NS);
+    size_t current = position;
+    while (current < earliest && !custom_atomic_compare_exchange_weak(&bucket->taken_chunks, &current, earliest)) {
+    }
+  }
+
+  account->taken += count * bucket->chunk;
+  account->due_ns = due_ns;
+
+  return due_ns;
+}
+
+static uint64_t rate_bucket_time(const rate_bucket_t *bucket, size_t chunks) {
+  assert(NULL != bucket);
+
+  // the schedule is computed from the start every time, so rounding errors do not accumulate
+  return bucket->start_ns + (uint64_t)((double)chunks * (double)bucket->chunk * 1.0E9 / (double)bucket->rate);
+}
+
+static size_t rate_bucket_chunks(const rate_bucket_t *bucket, uint64_t time_ns) {
+  assert(NULL != bucket);
+
+  if (time_ns <= bucket->start_ns) {
+    return 0;
+  }
+
+  return (size_t)((double)(time_ns - bucket->start_ns) * (double)bucket->rate / (1.0E9 * (double)bucket->chunk));
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "./atomic.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// credits are earned at a constant rate since start_ns, workers take them in chunks from the shared counter
+typedef struct _rate_bucket_t {
+  // credits per second, zero if the bucket does not limit anything
+  uint64_t rate;
+  uint64_t chunk;
+  uint64_t start_ns;
+  // count of chunks taken by all workers
+  custom_atomic_size_t taken_chunks;
+} rate_bucket_t;
+
+// credits of one worker, only this worker uses it
+typedef struct _rate_account_t {
+  uint64_t taken;
+  // the last taken credit is earned at this time
+  uint64_t due_ns;
+} rate_account_t;
+
+extern void rate_bucket_init(rate_bucket_t *bucket, uint64_t rate, uint64_t start_ns);
+extern bool rate_bucket_is_limited(const rate_bucket_t *bucket);
+
+// takes new credits if the worker has used all of them, returns the time when the worker may continue
+extern uint64_t rate_account_take(rate_account_t *account, rate_bucket_t *bucket, uint64_t used, uint64_t time_ns);
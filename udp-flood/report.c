@@ -0,0 +1,243 @@
+#include "./report.h"
+#include "./globals.h"
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <uv.h>
+
+// records are collected here and written at once, so log lines on stdout do not split them
+#define REPORT_BUFFER_SIZE (64 * 1024)
+
+static report_format_e s_report_format = report_format_text;
+static FILE *s_report_file = NULL;
+static char *s_report_buffer = NULL;
+static size_t s_report_length = 0;
+static bool s_report_first = false;
+static uint64_t s_report_elapsed_ns = 0;
+static double s_report_interval_sec = 1.0;
+
+static void report_print(const char *format, ...);
+static void report_flush(void);
+static void report_latency(const char *name, const histogram_values_t *values);
+static void report_sizes(const stats_values_t *values);
+
+int report_open(report_format_e format, const char *path) {
+  assert(NULL == s_report_file);
+
+  s_report_format = format;
+  if (report_format_text == format) {
+    return 0;
+  }
+
+  s_report_buffer = (char *)malloc(REPORT_BUFFER_SIZE);
+  if (NULL == s_report_buffer) {
+    return UV_ENOMEM;
+  }
+
+  if (NULL == path) {
+    s_report_file = stdout;
+  } else {
+    int err = fopen_s(&s_report_file, path, "w");
+    if (err || NULL == s_report_file) {
+      free(s_report_buffer);
+      s_report_buffer = NULL;
+      s_report_file = NULL;
+      return uv_translate_sys_error(err ? err : EINVAL);
+    }
+  }
+
+  s_report_length = 0;
+
+  if (report_format_csv == format) {
+    report_print("elapsed_ms,interval_ms,worker,bytes_per_sec,operations_per_sec,messages_per_sec,syscalls_per_sec,"
+                 "inflight,errors,total_bytes,total_operations,total_errors,schedule_p50_ns,schedule_p99_ns,"
+                 "schedule_p999_ns,schedule_max_ns,send_p50_ns,send_p99_ns,send_p999_ns,send_max_ns,missing,reordered,"
+                 "duplicates,one_way_p50_ns,one_way_p99_ns,one_way_p999_ns,one_way_max_ns,rtt_p50_ns,rtt_p99_ns,"
+                 "rtt_p999_ns,rtt_max_ns,mean_size,fragments_per_sec,total_fragments,connects\n");
+    report_flush();
+  }
+
+  return 0;
+}
+
+void report_close(void) {
+  if (NULL == s_report_file) {
+    return;
+  }
+
+  report_flush();
+
+  if (stdout != s_report_file) {
+    fclose(s_report_file);
+  }
+
+  free(s_report_buffer);
+
+  s_report_file = NULL;
+  s_report_buffer = NULL;
+  s_report_length = 0;
+}
+
+void report_begin(uint64_t elapsed_ns, uint64_t interval_ns) {
+  if (NULL == s_report_file) {
+    return;
+  }
+
+  s_report_elapsed_ns = elapsed_ns;
+  s_report_interval_sec = interval_ns ? interval_ns / 1.0E9 : 1.0;
+  s_report_first = true;
+
+  if (report_format_json == s_report_format) {
+    report_print("{\"elapsed_ms\":%.1f,\"interval_ms\":%.1f,\"workers\":[", elapsed_ns / 1.0E6,
+                 s_report_interval_sec * 1.0E3);
+  }
+}
+
+void report_values(unsigned int index, const stats_values_t *tick, const stats_values_t *total) {
+  assert(NULL != tick);
+  assert(NULL != total);
+
+  if (NULL == s_report_file) {
+    return;
+  }
+
+  double bytes = tick->sent_bytes / s_report_interval_sec;
+  double operations = tick->sent_operations / s_report_interval_sec;
+  double messages = tick->sent_messages / s_report_interval_sec;
+  double syscalls = tick->sent_syscalls / s_report_interval_sec;
+  double fragments = tick->sent_fragments / s_report_interval_sec;
+  double mean_size = tick->sent_operations ? (double)tick->sent_bytes / (double)tick->sent_operations : 0.0;
+
+  if (report_format_json == s_report_format) {
+    // the sum of all workers is not an item of the workers array
+    if (0 != index && !s_report_first) {
+      report_print(",");
+    }
+
+    s_report_first = false;
+
+    report_print("{\"worker\":%u,\"bytes_per_sec\":%.0f,\"operations_per_sec\":%.0f,\"messages_per_sec\":%.0f,"
+                 "\"syscalls_per_sec\":%.0f,\"inflight\":%" PRIu64 ",\"errors\":%" PRIu64 ",\"total_bytes\":%" PRIu64
+                 ",\"total_operations\":%" PRIu64 ",\"total_errors\":%" PRIu64 ",",
+                 index, bytes, operations, messages, syscalls, tick->sent_inflight, tick->sent_errors, total->sent_bytes,
+                 total->sent_operations, total->sent_errors);
+    report_latency("schedule_latency_ns", &tick->schedule_latency);
+    report_print(",");
+    report_latency("send_latency_ns", &tick->send_latency);
+    report_print(",\"missing\":%" PRIu64 ",\"reordered\":%" PRIu64 ",\"duplicates\":%" PRIu64 ",", tick->probe_missing,
+                 tick->probe_reordered, tick->probe_duplicates);
+    report_latency("one_way_latency_ns", &tick->probe_latency);
+    report_print(",");
+    report_latency("rtt_ns", &tick->rtt_latency);
+    report_print(",\"mean_size\":%.1f,\"fragments_per_sec\":%.0f,\"total_fragments\":%" PRIu64 ",\"connects\":%" PRIu64,
+                 mean_size, fragments, total->sent_fragments, tick->sent_connects);
+    report_sizes(tick);
+    report_print("}");
+  } else {
+    report_print("%.1f,%.1f,%u,%.0f,%.0f,%.0f,%.0f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",",
+                 s_report_elapsed_ns / 1.0E6, s_report_interval_sec * 1.0E3, index, bytes, operations, messages,
+                 syscalls, tick->sent_inflight, tick->sent_errors, total->sent_bytes, total->sent_operations,
+                 total->sent_errors);
+    report_latency(NULL, &tick->schedule_latency);
+    report_print(",");
+    report_latency(NULL, &tick->send_latency);
+    report_print(",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",", tick->probe_missing, tick->probe_reordered,
+                 tick->probe_duplicates);
+    report_latency(NULL, &tick->probe_latency);
+    report_print(",");
+    report_latency(NULL, &tick->rtt_latency);
+    report_print(",%.1f,%.0f,%" PRIu64 ",%" PRIu64 "\n", mean_size, fragments, total->sent_fragments,
+                 tick->sent_connects);
+  }
+}
+
+void report_end(const stats_values_t *tick, const stats_values_t *total) {
+  assert(NULL != tick);
+  assert(NULL != total);
+
+  if (NULL == s_report_file) {
+    return;
+  }
+
+  if (report_format_json == s_report_format) {
+    report_print("],\"total\":");
+    report_values(0, tick, total);
+    report_print("}\n");
+  } else {
+    report_values(0, tick, total);
+  }
+
+  report_flush();
+}
+
+static void report_print(const char *format, ...) {
+  assert(NULL != format);
+  assert(NULL != s_report_buffer);
+
+  int length = 0;
+  int attempt = 0;
+  for (attempt = 0; attempt < 2; ++attempt) {
+    va_list args;
+    va_start(args, format);
+    length = vsnprintf(s_report_buffer + s_report_length, REPORT_BUFFER_SIZE - s_report_length, format, args);
+    va_end(args);
+
+    if (length < 0) {
+      return;
+    } else if ((size_t)length < REPORT_BUFFER_SIZE - s_report_length) {
+      s_report_length += (size_t)length;
+      return;
+    }
+
+    // the text did not fit, it is printed again into the empty buffer
+    report_flush();
+  }
+}
+
+static void report_flush(void) {
+  if (0 == s_report_length) {
+    return;
+  }
+
+  fwrite(s_report_buffer, 1, s_report_length, s_report_file);
+  fflush(s_report_file);
+
+  s_report_length = 0;
+}
+
+static void report_latency(const char *name, const histogram_values_t *values) {
+  assert(NULL != values);
+
+  uint64_t p50 = histogram_percentile(values, 50.0);
+  uint64_t p99 = histogram_percentile(values, 99.0);
+  uint64_t p999 = histogram_percentile(values, 99.9);
+
+  if (NULL != name) {
+    report_print("\"%s\":{\"p50\":%" PRIu64 ",\"p99\":%" PRIu64 ",\"p99.9\":%" PRIu64 ",\"max\":%" PRIu64 "}", name, p50,
+                 p99, p999, values->maximum);
+  } else {
+    report_print("%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64, p50, p99, p999, values->maximum);
+  }
+}
+
+static void report_sizes(const stats_values_t *values) {
+  assert(NULL != values);
+
+  if (0 == g_size_profile.count) {
+    return;
+  }
+
+  // pairs of the size and the datagrams of each entry of the profile
+  report_print(",\"sizes\":[");
+
+  unsigned int index = 0;
+  for (index = 0; index < g_size_profile.count; ++index) {
+    report_print("%s[%d,%" PRIu64 "]", index ? "," : "", g_size_profile.sizes[index], values->profile_counts[index]);
+  }
+
+  report_print("]");
+}
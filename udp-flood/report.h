@@ -0,0 +1,19 @@
+#pragma once
+
+#include "./stats.h"
+#include <stdint.h>
+
+typedef enum _report_format_e {
+  report_format_text,
+  report_format_json,
+  report_format_csv,
+} report_format_e;
+
+// records are written to stdout if the path is NULL, the text format does not write records
+extern int report_open(report_format_e format, const char *path);
+extern void report_close(void);
+
+// one record per stats tick, the workers go first and the sum of all workers ends the record
+extern void report_begin(uint64_t elapsed_ns, uint64_t interval_ns);
+extern void report_values(unsigned int index, const stats_values_t *tick, const stats_values_t *total);
+extern void report_end(const stats_values_t *tick, const stats_values_t *total);
@@ -0,0 +1,155 @@
+#include "./stats.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef union _stats_entry_t {
+  stats_counters_t counters;
+  uint8_t padding[(sizeof(stats_counters_t) + STATS_CACHE_LINE_SIZE - 1) / STATS_CACHE_LINE_SIZE * STATS_CACHE_LINE_SIZE];
+} stats_entry_t;
+
+static void *s_stats_memory = NULL;
+static stats_entry_t *s_stats_entries = NULL;
+static stats_values_t *s_stats_previous = NULL;
+static unsigned int s_stats_count = 0;
+
+static void stats_load(stats_counters_t *counters, stats_values_t *total);
+
+bool stats_init(unsigned int workers_count) {
+  assert(NULL == s_stats_memory);
+  assert(0 != workers_count);
+
+  // malloc does not align to cache lines, so the entries start at the first aligned byte
+  s_stats_memory = calloc(1, workers_count * sizeof(stats_entry_t) + STATS_CACHE_LINE_SIZE);
+  s_stats_previous = (stats_values_t *)calloc(workers_count, sizeof(*s_stats_previous));
+  if (NULL == s_stats_memory || NULL == s_stats_previous) {
+    stats_term();
+    return false;
+  }
+
+  uintptr_t address = (uintptr_t)s_stats_memory;
+  address = (address + STATS_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(STATS_CACHE_LINE_SIZE - 1);
+
+  s_stats_entries = (stats_entry_t *)address;
+  s_stats_count = workers_count;
+
+  return true;
+}
+
+void stats_term(void) {
+  free(s_stats_memory);
+  free(s_stats_previous);
+
+  s_stats_memory = NULL;
+  s_stats_entries = NULL;
+  s_stats_previous = NULL;
+  s_stats_count = 0;
+}
+
+stats_counters_t *stats_get(unsigned int index) {
+  assert(0 < index && index <= s_stats_count);
+
+  return &s_stats_entries[index - 1].counters;
+}
+
+void stats_read(unsigned int index, stats_values_t *total) {
+  assert(0 < index && index <= s_stats_count);
+  assert(NULL != total);
+
+  stats_counters_t *counters = &s_stats_entries[index - 1].counters;
+
+  stats_load(counters, total);
+
+  histogram_read(&counters->schedule_latency, &total->schedule_latency);
+  histogram_read(&counters->send_latency, &total->send_latency);
+  histogram_read(&counters->probe_latency, &total->probe_latency);
+  histogram_read(&counters->rtt_latency, &total->rtt_latency);
+}
+
+void stats_collect(unsigned int index, stats_values_t *total, stats_values_t *tick) {
+  assert(0 < index && index <= s_stats_count);
+  assert(NULL != total);
+  assert(NULL != tick);
+
+  stats_counters_t *counters = &s_stats_entries[index - 1].counters;
+  stats_values_t *previous = &s_stats_previous[index - 1];
+
+  stats_load(counters, total);
+
+  tick->sent_bytes = total->sent_bytes - previous->sent_bytes;
+  tick->sent_operations = total->sent_operations - previous->sent_operations;
+  tick->sent_messages = total->sent_messages - previous->sent_messages;
+  tick->sent_syscalls = total->sent_syscalls - previous->sent_syscalls;
+  // requests in flight are a level, not a sum
+  tick->sent_inflight = total->sent_inflight;
+  tick->sent_errors = total->sent_errors - previous->sent_errors;
+  tick->sent_fragments = total->sent_fragments - previous->sent_fragments;
+  tick->sent_connects = total->sent_connects - previous->sent_connects;
+
+  histogram_collect(&counters->schedule_latency, &previous->schedule_latency, &total->schedule_latency,
+                    &tick->schedule_latency);
+  histogram_collect(&counters->send_latency, &previous->send_latency, &total->send_latency, &tick->send_latency);
+
+  tick->probe_missing = total->probe_missing;
+  tick->probe_reordered = total->probe_reordered - previous->probe_reordered;
+  tick->probe_duplicates = total->probe_duplicates - previous->probe_duplicates;
+  histogram_collect(&counters->probe_latency, &previous->probe_latency, &total->probe_latency, &tick->probe_latency);
+  histogram_collect(&counters->rtt_latency, &previous->rtt_latency, &total->rtt_latency, &tick->rtt_latency);
+
+  size_t entry = 0;
+  for (entry = 0; entry < PROFILE_MAXIMAL_ENTRIES; ++entry) {
+    tick->profile_counts[entry] = total->profile_counts[entry] - previous->profile_counts[entry];
+  }
+
+  *previous = *total;
+}
+
+void stats_add(stats_values_t *values, const stats_values_t *other) {
+  assert(NULL != values);
+  assert(NULL != other);
+
+  values->sent_bytes += other->sent_bytes;
+  values->sent_operations += other->sent_operations;
+  values->sent_messages += other->sent_messages;
+  values->sent_syscalls += other->sent_syscalls;
+  values->sent_inflight += other->sent_inflight;
+  values->sent_errors += other->sent_errors;
+  values->sent_fragments += other->sent_fragments;
+  values->sent_connects += other->sent_connects;
+
+  histogram_add(&values->schedule_latency, &other->schedule_latency);
+  histogram_add(&values->send_latency, &other->send_latency);
+
+  values->probe_missing += other->probe_missing;
+  values->probe_reordered += other->probe_reordered;
+  values->probe_duplicates += other->probe_duplicates;
+  histogram_add(&values->probe_latency, &other->probe_latency);
+  histogram_add(&values->rtt_latency, &other->rtt_latency);
+
+  size_t entry = 0;
+  for (entry = 0; entry < PROFILE_MAXIMAL_ENTRIES; ++entry) {
+    values->profile_counts[entry] += other->profile_counts[entry];
+  }
+}
+
+static void stats_load(stats_counters_t *counters, stats_values_t *total) {
+  assert(NULL != counters);
+  assert(NULL != total);
+
+  total->sent_bytes = (uint64_t)custom_atomic_load_relaxed(&counters->sent_bytes);
+  total->sent_operations = (uint64_t)custom_atomic_load_relaxed(&counters->sent_operations);
+  total->sent_messages = (uint64_t)custom_atomic_load_relaxed(&counters->sent_messages);
+  total->sent_syscalls = (uint64_t)custom_atomic_load_relaxed(&counters->sent_syscalls);
+  total->sent_inflight = (uint64_t)custom_atomic_load_relaxed(&counters->sent_inflight);
+  total->sent_errors = (uint64_t)custom_atomic_load_relaxed(&counters->sent_errors);
+  total->sent_fragments = (uint64_t)custom_atomic_load_relaxed(&counters->sent_fragments);
+  total->sent_connects = (uint64_t)custom_atomic_load_relaxed(&counters->sent_connects);
+  total->probe_missing = (uint64_t)custom_atomic_load_relaxed(&counters->probe_missing);
+  total->probe_reordered = (uint64_t)custom_atomic_load_relaxed(&counters->probe_reordered);
+  total->probe_duplicates = (uint64_t)custom_atomic_load_relaxed(&counters->probe_duplicates);
+
+  size_t entry = 0;
+  for (entry = 0; entry < PROFILE_MAXIMAL_ENTRIES; ++entry) {
+    total->profile_counts[entry] = (uint64_t)custom_atomic_load_relaxed(&counters->profile_counts[entry]);
+  }
+}
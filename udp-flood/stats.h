@@ -0,0 +1,78 @@
+#pragma once
+
+#include "./atomic.h"
+#include "./histogram.h"
+#include "./profile.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// an entry covers whole cache lines, including the adjacent line prefetched together with it
+#define STATS_CACHE_LINE_SIZE 128
+
+// counters of one worker, only the worker writes them and the stats timer reads them
+typedef struct _stats_counters_t {
+  custom_atomic_size_t sent_bytes;
+  custom_atomic_size_t sent_operations;
+  custom_atomic_size_t sent_messages;
+  custom_atomic_size_t sent_syscalls;
+  custom_atomic_size_t sent_inflight;
+  // sends refused by the OS and not retried
+  custom_atomic_size_t sent_errors;
+  // IP packets of the sent datagrams, a datagram larger than the MTU is split into several fragments
+  custom_atomic_size_t sent_fragments;
+  // sockets of --connect connected to a new destination
+  custom_atomic_size_t sent_connects;
+  // nanoseconds from the time a send was due to its submission, and from the submission to the completion
+  histogram_t schedule_latency;
+  histogram_t send_latency;
+  // datagrams of --header received by --sink, missing datagrams are a level
+  custom_atomic_size_t probe_missing;
+  custom_atomic_size_t probe_reordered;
+  custom_atomic_size_t probe_duplicates;
+  // nanoseconds from the send time in the header to the reception
+  histogram_t probe_latency;
+  // nanoseconds from the send time in the header to the reception of the reply of --rtt
+  histogram_t rtt_latency;
+  // datagrams of each entry of --size-profile
+  custom_atomic_size_t profile_counts[PROFILE_MAXIMAL_ENTRIES];
+} stats_counters_t;
+
+typedef struct _stats_values_t {
+  uint64_t sent_bytes;
+  uint64_t sent_operations;
+  uint64_t sent_messages;
+  uint64_t sent_syscalls;
+  uint64_t sent_inflight;
+  uint64_t sent_errors;
+  uint64_t sent_fragments;
+  uint64_t sent_connects;
+  histogram_values_t schedule_latency;
+  histogram_values_t send_latency;
+  uint64_t probe_missing;
+  uint64_t probe_reordered;
+  uint64_t probe_duplicates;
+  histogram_values_t probe_latency;
+  histogram_values_t rtt_latency;
+  uint64_t profile_counts[PROFILE_MAXIMAL_ENTRIES];
+} stats_values_t;
+
+// only the worker writes its counters, so a relaxed load and store replace a locked read-modify-write,
+// the reader sees either the old or the new value
+static inline void stats_counter_add(custom_atomic_size_t *counter, size_t value) {
+  custom_atomic_store_relaxed(counter, custom_atomic_load_relaxed(counter) + value);
+}
+
+static inline void stats_counter_sub(custom_atomic_size_t *counter, size_t value) {
+  custom_atomic_store_relaxed(counter, custom_atomic_load_relaxed(counter) - value);
+}
+
+extern bool stats_init(unsigned int workers_count);
+extern void stats_term(void);
+
+extern stats_counters_t *stats_get(unsigned int index);
+
+// reads the counters without changing the previous values of stats_collect
+extern void stats_read(unsigned int index, stats_values_t *total);
+
+extern void stats_collect(unsigned int index, stats_values_t *total, stats_values_t *tick);
+extern void stats_add(stats_values_t *values, const stats_values_t *other);
@@ -0,0 +1,83 @@
+#include "./sweep.h"
+#include <assert.h>
+#include <string.h>
+
+#undef countof
+#define countof(_x) (sizeof((_x)) / sizeof((_x)[0]))
+
+static uint64_t sweep_mix(uint64_t value);
+
+bool sweep_init(sweep_t *sweep, const address_range_t *range, int port_min, int port_max, uint64_t seed) {
+  assert(NULL != sweep);
+  assert(NULL != range);
+  assert(port_min <= port_max);
+
+  memset(sweep, 0, sizeof(*sweep));
+
+  sweep->range = range;
+  sweep->port_min = port_min;
+  sweep->ports_count = (uint64_t)(port_max - port_min + 1);
+
+  if (range->bits + 16 > SWEEP_MAXIMAL_BITS) {
+    return false;
+  }
+  sweep->size = (1ull << range->bits) * sweep->ports_count;
+
+  unsigned int bits = 1;
+  while (bits < 64 && (1ull << bits) < sweep->size) {
+    ++bits;
+  }
+
+  sweep->half_bits = (bits + 1) / 2;
+  sweep->half_mask = (1ull << sweep->half_bits) - 1;
+
+  size_t round = 0;
+  for (round = 0; round < countof(sweep->keys); ++round) {
+    seed = sweep_mix(seed + round);
+    sweep->keys[round] = seed;
+  }
+
+  return true;
+}
+
+uint64_t sweep_permute(const sweep_t *sweep, uint64_t position) {
+  assert(NULL != sweep);
+  assert(position < sweep->size);
+
+  // cycle walking keeps the result inside of [0, size), the domain is at most 4 times bigger than size
+  do {
+    uint64_t left = position >> sweep->half_bits;
+    uint64_t right = position & sweep->half_mask;
+
+    size_t round = 0;
+    for (round = 0; round < countof(sweep->keys); ++round) {
+      uint64_t next = left ^ (sweep_mix(right ^ sweep->keys[round]) & sweep->half_mask);
+      left = right;
+      right = next;
+    }
+
+    position = (left << sweep->half_bits) | right;
+  } while (position >= sweep->size);
+
+  return position;
+}
+
+void sweep_destination(const sweep_t *sweep, uint64_t position, sockaddr_any *sockaddr) {
+  assert(NULL != sweep);
+  assert(NULL != sockaddr);
+
+  uint64_t value = sweep_permute(sweep, position);
+
+  int port = sweep->port_min + (int)(value % sweep->ports_count);
+  value /= sweep->ports_count;
+
+  address_range_at(sweep->range, value, port, sockaddr);
+}
+
+static uint64_t sweep_mix(uint64_t value) {
+  // splitmix64 finalizer
+  value += 0x9e3779b97f4a7c15ull;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+  return value ^ (value >> 31);
+}
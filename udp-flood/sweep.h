@@ -0,0 +1,26 @@
+#pragma once
+
+#include "./address.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SWEEP_ROUNDS 4
+#define SWEEP_MAXIMAL_BITS 62
+
+typedef struct _sweep_t {
+  const address_range_t *range;
+  int port_min;
+  uint64_t ports_count;
+  // count of (address, port) pairs
+  uint64_t size;
+
+  // the permutation works on [0, 2^(2 * half_bits)), values outside of [0, size) are skipped
+  unsigned int half_bits;
+  uint64_t half_mask;
+  uint64_t keys[SWEEP_ROUNDS];
+} sweep_t;
+
+extern bool sweep_init(sweep_t *sweep, const address_range_t *range, int port_min, int port_max, uint64_t seed);
+
+extern uint64_t sweep_permute(const sweep_t *sweep, uint64_t position);
+extern void sweep_destination(const sweep_t *sweep, uint64_t position, sockaddr_any *sockaddr);
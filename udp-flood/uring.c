@@ -0,0 +1,209 @@
+#include "./uring.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <uv.h>
+
+// the rings are shared with the kernel, so the indexes are published with acquire/release semantics
+#define uring_load_acquire(_ptr) __atomic_load_n((_ptr), __ATOMIC_ACQUIRE)
+#define uring_store_release(_ptr, _value) __atomic_store_n((_ptr), (_value), __ATOMIC_RELEASE)
+
+static int uring_syscall_setup(unsigned int entries, struct io_uring_params *params);
+static int uring_syscall_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags);
+static int uring_syscall_register(int fd, unsigned int opcode, const void *arg, unsigned int nr_args);
+
+int uring_init(uring_t *ring, unsigned int entries) {
+  assert(NULL != ring);
+
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = uring_syscall_setup(entries, &params);
+  if (fd < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  ring->fd = fd;
+  ring->features = params.features;
+
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  if (ring->features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_ring_size > ring->sq_ring_size) {
+      ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == ring->sq_ring) {
+    int err = uv_translate_sys_error(errno);
+    ring->sq_ring = NULL;
+    uring_term(ring);
+    return err;
+  }
+
+  if (ring->features & IORING_FEAT_SINGLE_MMAP) {
+    ring->cq_ring = ring->sq_ring;
+  } else {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (MAP_FAILED == ring->cq_ring) {
+      int err = uv_translate_sys_error(errno);
+      ring->cq_ring = NULL;
+      uring_term(ring);
+      return err;
+    }
+  }
+
+  ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                           IORING_OFF_SQES);
+  if (MAP_FAILED == ring->sqes) {
+    int err = uv_translate_sys_error(errno);
+    ring->sqes = NULL;
+    uring_term(ring);
+    return err;
+  }
+
+  uint8_t *sq_ring = (uint8_t *)ring->sq_ring;
+  ring->sq_head = (unsigned int *)(sq_ring + params.sq_off.head);
+  ring->sq_tail = (unsigned int *)(sq_ring + params.sq_off.tail);
+  ring->sq_mask = *(unsigned int *)(sq_ring + params.sq_off.ring_mask);
+  ring->sq_entries = *(unsigned int *)(sq_ring + params.sq_off.ring_entries);
+
+  unsigned int *sq_array = (unsigned int *)(sq_ring + params.sq_off.array);
+  unsigned int index = 0;
+  for (index = 0; index < ring->sq_entries; ++index) {
+    sq_array[index] = index;
+  }
+
+  ring->sq_local_tail = ring->sq_submitted_tail = *ring->sq_tail;
+
+  uint8_t *cq_ring = (uint8_t *)ring->cq_ring;
+  ring->cq_head = (unsigned int *)(cq_ring + params.cq_off.head);
+  ring->cq_tail = (unsigned int *)(cq_ring + params.cq_off.tail);
+  ring->cq_mask = *(unsigned int *)(cq_ring + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+
+  return 0;
+}
+
+void uring_term(uring_t *ring) {
+  assert(NULL != ring);
+
+  if (NULL != ring->sqes) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (NULL != ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (NULL != ring->sq_ring) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  if (ring->fd >= 0) {
+    close(ring->fd);
+  }
+
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+int uring_register_files(uring_t *ring, const int *fds, unsigned int count) {
+  assert(NULL != ring);
+  assert(NULL != fds);
+
+  if (0 != uring_syscall_register(ring->fd, IORING_REGISTER_FILES, fds, count)) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+int uring_register_eventfd(uring_t *ring, int eventfd) {
+  assert(NULL != ring);
+
+  if (0 != uring_syscall_register(ring->fd, IORING_REGISTER_EVENTFD, &eventfd, 1)) {
+    return uv_translate_sys_error(errno);
+  }
+
+  return 0;
+}
+
+struct io_uring_sqe *uring_get_sqe(uring_t *ring) {
+  assert(NULL != ring);
+
+  unsigned int head = uring_load_acquire(ring->sq_head);
+  if (ring->sq_local_tail - head >= ring->sq_entries) {
+    return NULL;
+  }
+
+  struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+  ++ring->sq_local_tail;
+
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+int uring_submit(uring_t *ring, unsigned int wait_count) {
+  assert(NULL != ring);
+
+  unsigned int to_submit = ring->sq_local_tail - ring->sq_submitted_tail;
+  if (0 == to_submit && 0 == wait_count) {
+    return 0;
+  }
+
+  uring_store_release(ring->sq_tail, ring->sq_local_tail);
+
+  int submitted = 0;
+  do {
+    submitted = uring_syscall_enter(ring->fd, to_submit, wait_count, wait_count ? IORING_ENTER_GETEVENTS : 0);
+  } while (submitted < 0 && EINTR == errno);
+
+  if (submitted < 0) {
+    return uv_translate_sys_error(errno);
+  }
+
+  ring->sq_submitted_tail += (unsigned int)submitted;
+  return submitted;
+}
+
+unsigned int uring_reap(uring_t *ring, uring_completion_cb callback, void *data) {
+  assert(NULL != ring);
+  assert(NULL != callback);
+
+  unsigned int head = *ring->cq_head;
+  unsigned int tail = uring_load_acquire(ring->cq_tail);
+  unsigned int count = 0;
+
+  for (; head != tail; ++head, ++count) {
+    const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+    callback(data, cqe->user_data, cqe->res);
+  }
+
+  uring_store_release(ring->cq_head, head);
+  return count;
+}
+
+static int uring_syscall_setup(unsigned int entries, struct io_uring_params *params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_syscall_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_syscall_register(int fd, unsigned int opcode, const void *arg, unsigned int nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+#endif /*PLATFORM_LINUX*/
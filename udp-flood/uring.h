@@ -0,0 +1,50 @@
+#pragma once
+
+#include "./platform.h"
+
+#if defined(PLATFORM_LINUX)
+
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void (*uring_completion_cb)(void *data, uint64_t user_data, int res);
+
+typedef struct _uring_t {
+  int fd;
+  unsigned int features;
+
+  // submission queue, the array is an identity mapping to sqes
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int sq_mask;
+  unsigned int sq_entries;
+  struct io_uring_sqe *sqes;
+  unsigned int sq_local_tail;
+  unsigned int sq_submitted_tail;
+
+  // completion queue
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+} uring_t;
+
+extern int uring_init(uring_t *ring, unsigned int entries);
+extern void uring_term(uring_t *ring);
+
+extern int uring_register_files(uring_t *ring, const int *fds, unsigned int count);
+extern int uring_register_eventfd(uring_t *ring, int eventfd);
+
+extern struct io_uring_sqe *uring_get_sqe(uring_t *ring);
+extern int uring_submit(uring_t *ring, unsigned int wait_count);
+extern unsigned int uring_reap(uring_t *ring, uring_completion_cb callback, void *data);
+
+#endif /*PLATFORM_LINUX*/
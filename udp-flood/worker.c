@@ -1,16 +1,66 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// sendmmsg is a GNU extension
+#define _GNU_SOURCE
+#endif /*__linux__*/
+
 #include "./worker.h"
+#include "./address.h"
+#include "./affinity.h"
 #include "./globals.h"
 #include "./logger.h"
 #include "./loop.h"
+#include "./packet.h"
+#include "./pacer.h"
+#include "./payload.h"
+#include "./probe.h"
 #include "./random.h"
+#include "./rate.h"
+#include "./stats.h"
+#include "./sweep.h"
+#include "./uring.h"
 #include <assert.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
 #include <uv.h>
 
+#if defined(PLATFORM_LINUX)
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <linux/errqueue.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if !defined(UDP_SEGMENT)
+#define UDP_SEGMENT 103
+#endif /*UDP_SEGMENT*/
+
+// the packet ring holds a few batches, so the kernel can send one batch while the next one is filled
+#define MINIMAL_PACKET_FRAMES 256
+
+// the busy-poll loop checks the stop flag at least this often while the socket buffer is full
+#define BUSY_POLL_TIMEOUT_MS 100
+
+// the sink returns to the loop after this many full batches, so the stop request is not delayed
+#define SINK_ROUNDS 16
+#endif /*PLATFORM_LINUX*/
+
 #undef countof
 #define countof(_x) (sizeof((_x)) / sizeof((_x)[0]))
 
+// datagrams are random slices of the pool, so it should be much larger than one datagram
+#define PAYLOAD_POOL_SIZE (1024 * 1024)
+
+// replies of --rtt are read only up to the header, the rest of them is truncated
+#define REPLY_BUFFER_SIZE 64
+
+// fragments are counted for this MTU if the route is unknown, for example toward a host name
+#define DEFAULT_MTU 1500
+#define UDP_HEADER_SIZE 8
+
 typedef enum _worker_state_e {
   worker_state_unknown,
   worker_state_failed,
@@ -18,11 +68,53 @@ typedef enum _worker_state_e {
   worker_state_stopped,
 } worker_state_e;
 
-typedef union _sockaddr_any {
-  struct sockaddr addr;
-  struct sockaddr_in addr4;
-  struct sockaddr_in6 addr6;
-} sockaddr_any;
+// a socket of --connect, the kernel keeps the route of its destination and sends need no address
+typedef struct _worker_connection_t {
+  uv_udp_t socket;
+  sockaddr_any destination;
+  bool is_open;
+  bool is_connected;
+
+  // sequence of the next --header, the socket has its own source port, so --sink sees it as its own flow
+  uint64_t header_sequence;
+
+  // sends in flight, the socket gets another destination only without them
+  unsigned int inflight;
+  // the least recently used socket gets the next destination which is not cached
+  uint64_t used;
+} worker_connection_t, *worker_connection_p;
+
+typedef struct _worker_slot_t {
+  worker_p worker;
+
+  uv_udp_send_t send_request;
+  uv_getaddrinfo_t addr_request;
+
+  sockaddr_any sockaddr;
+  char address[256];
+  char port[16];
+
+  // with --header the header is sent in front of the payload slice
+  uint8_t header[PROBE_HEADER_SIZE];
+  uv_buf_t bufs[2];
+  unsigned int bufs_count;
+  size_t size;
+
+  // latency of the send, the completion records it to the histograms
+  uint64_t scheduled_ns;
+  uint64_t submit_ns;
+
+  // connected socket of the send, NULL if the socket of the worker sends it with an address
+  worker_connection_p connection;
+} worker_slot_t, *worker_slot_p;
+
+#if defined(PLATFORM_LINUX)
+typedef struct _worker_frame_t {
+  // payload size and checksum of the payload, the payload itself is never changed
+  size_t size;
+  uint32_t sum;
+} worker_frame_t;
+#endif /*PLATFORM_LINUX*/
 
 typedef struct _worker_t {
   unsigned int index;
@@ -31,22 +123,115 @@ typedef struct _worker_t {
   custom_atomic_int refs_counter;
   worker_state_e state;
 
+  // the busy-poll loop checks this flag between sends instead of locking the mutex of the state
+  custom_atomic_bool is_stopping;
+
+  // padded counters written only by this worker
+  stats_counters_t *stats;
+
   uv_loop_t *loop;
   uv_async_t term;
   uv_async_t send;
   uv_timer_t wait;
 
-  sockaddr_any sockaddr;
-  char address[256];
-  char port[16];
+  uint64_t sweep_position;
+  uint64_t sweep_passes;
 
   uv_udp_t socket;
-  uv_udp_send_t send_request;
-  uv_getaddrinfo_t addr_request;
 
-  uint8_t *datagram;
-  size_t datagram_max_size;
-  uv_buf_t buf;
+  // g_arg_source_ports - 1 more sockets of the libuv engine, sends rotate over the socket of the worker and these,
+  // sources_count of them are initialized
+  uv_udp_t *sources;
+  unsigned int sources_count;
+
+  // socket of the current send and of the next one, engines with plain sockets rotate them the same way
+  unsigned int source_index;
+  unsigned int source_next;
+
+  // the libuv engine keeps g_arg_depth sends in flight, every slot owns a request and a destination
+  worker_slot_t *slots;
+  worker_slot_p *slots_free;
+  unsigned int slots_free_count;
+
+  payload_pool_t payload;
+
+  // g_arg_connect sockets connected to the latest destinations, valid only if g_arg_connect > 0
+  worker_connection_t *connections;
+  uint64_t connections_clock;
+
+  // credits of the global --rate-pps and --rate-bps buckets
+  rate_account_t rate_operations;
+  rate_account_t rate_bytes;
+
+  // send time of --gap, it follows the ideal schedule instead of the previous send
+  uint64_t gap_next_ns;
+
+  // the latest deadline the current send waited for, and the time the sends of the current pass were due
+  uint64_t pace_due_ns;
+  uint64_t scheduled_ns;
+
+  // count of datagrams in one send, the kernel splits them if UDP GSO is enabled
+  unsigned int gso_segments;
+
+  // largest payload which fits one IP packet, and payload bytes of each fragment of a larger datagram
+  size_t fragment_threshold;
+  size_t fragment_step;
+
+  // sequences of the next --header of each socket, all destinations share them,
+  // --sink tells flows apart by the source address and port, so every socket has its own sequence
+  uint64_t *header_sequences;
+
+  // every reply of --rtt is read into this buffer, so receiving does not allocate
+  uint8_t reply_buffer[REPLY_BUFFER_SIZE];
+
+#if defined(PLATFORM_LINUX)
+  // descriptor of the current socket, and descriptors of all g_arg_source_ports sockets
+  uv_os_fd_t fd;
+  uv_os_fd_t *source_fds;
+
+  // flags of sendmsg and sendmmsg, MSG_ZEROCOPY if --zerocopy is enabled by the socket
+  int send_flags;
+  bool is_zerocopy_copied;
+
+  // these variables are valid only if g_arg_batch > 1 or g_arg_engine == engine_io_uring,
+  // every message has two iovecs, the header of --header and the payload
+  struct mmsghdr *batch_messages;
+  struct iovec *batch_iovecs;
+  sockaddr_any *batch_sockaddrs;
+  uint8_t *batch_headers;
+
+  // the first unsent datagram of a partially sent batch and the socket of the batch, 0 if the batch is complete
+  unsigned int batch_offset;
+  unsigned int batch_source;
+
+  // these variables are valid only if g_arg_engine == engine_io_uring
+  uring_t ring;
+  uv_poll_t ring_poll;
+  int ring_eventfd;
+  bool ring_fixed_file;
+  unsigned int ring_inflight;
+  unsigned int *ring_free;
+  unsigned int ring_free_count;
+  uint64_t *ring_submit_ns;
+
+  // these variables are valid only if g_arg_engine == engine_packet
+  packet_ring_t packet;
+  uv_poll_t packet_poll;
+  worker_frame_t *packet_frames;
+  size_t packet_headers_size;
+  unsigned int packet_pending;
+  size_t packet_pending_bytes;
+
+  // timerfd of precise waits, valid only if it is not negative
+  int pace_timerfd;
+  uv_poll_t pace_poll;
+
+  // these variables are valid only if g_arg_is_sink
+  int sink_socket;
+  uv_poll_t sink_poll;
+  uint8_t *sink_buffers;
+  probe_flows_t sink_flows;
+#endif /*PLATFORM_LINUX*/
 
   // these variables are valid only if index != 0
   uv_thread_t thread;
@@ -54,6 +239,7 @@ typedef struct _worker_t {
   uv_cond_t cond;
 } worker_t;
 
+static bool worker_prepare(worker_p worker);
 static bool worker_init(worker_p worker);
 
 static worker_p worker_retain(worker_p worker);
@@ -69,8 +255,71 @@ static void worker_handle_closed(uv_handle_t *handle);
 
 static void worker_async_send(uv_async_t *async);
 static void worker_timer_timeout(uv_timer_t *timer);
+static worker_slot_p worker_take_slot(worker_p worker);
+static void worker_return_slot(worker_p worker, worker_slot_p slot);
+static void worker_resolve_destination(worker_slot_p slot);
 static void worker_request_addr_completed(uv_getaddrinfo_t *req, int status, struct addrinfo *res);
+static void worker_next_destination(worker_p worker, sockaddr_any *sockaddr);
+static size_t worker_next_size(worker_p worker);
+static size_t worker_next_payload(worker_p worker, uint8_t **payload);
+static size_t worker_next_datagram(worker_p worker, uint8_t *header, uint64_t *sequence, uint64_t time_ns,
+                                   uint8_t **payload, size_t *payload_size);
+static void worker_set_bufs(worker_slot_p slot, uint8_t *payload, size_t payload_size);
+static void worker_send_datagram(worker_slot_p slot);
+static worker_connection_p worker_connection_take(worker_p worker, const sockaddr_any *destination);
+static bool worker_connection_open(worker_p worker, worker_connection_p connection, const sockaddr_any *destination);
+static bool worker_sources_init(worker_p worker);
+static void worker_sources_close(worker_p worker);
+static bool worker_source_address(worker_p worker, unsigned int index, sockaddr_any *sockaddr);
+static unsigned int worker_next_source(worker_p worker);
+static uv_udp_t *worker_source_socket(worker_p worker, unsigned int index);
+#if defined(PLATFORM_LINUX)
+static void worker_fill_batch(worker_p worker, unsigned int count);
+static void worker_fill_message(worker_p worker, unsigned int index, uint64_t time_ns);
+static size_t worker_message_size(worker_p worker, unsigned int index);
+static void worker_account_batch(worker_p worker, unsigned int offset, unsigned int sent);
+static void worker_send_batch(worker_p worker);
+static void worker_set_gso(worker_p worker, unsigned int segments);
+static bool worker_is_gso_refused(worker_p worker, int err);
+static bool worker_uring_init(worker_p worker);
+static void worker_uring_term(worker_p worker);
+static void worker_uring_send(worker_p worker);
+static void worker_uring_poll(uv_poll_t *poll, int status, int events);
+static void worker_uring_completed(void *data, uint64_t user_data, int res);
+static void worker_uring_discarded(void *data, uint64_t user_data, int res);
+static bool worker_packet_init(worker_p worker);
+static void worker_packet_term(worker_p worker);
+static void worker_packet_send(worker_p worker, const sockaddr_any *destination);
+static void worker_packet_poll(uv_poll_t *poll, int status, int events);
+static void worker_pace_init(worker_p worker);
+static void worker_pace_term(worker_p worker);
+static void worker_pace_poll(uv_poll_t *poll, int status, int events);
+static void worker_busy_proc(worker_p worker);
+static bool worker_busy_send(worker_p worker);
+static bool worker_busy_wait(worker_p worker, uint64_t due_ns);
+static bool worker_sink_init(worker_p worker);
+static void worker_sink_term(worker_p worker);
+static void worker_sink_poll(uv_poll_t *poll, int status, int events);
+static void worker_sink_reflect(worker_p worker, unsigned int count);
+static void worker_set_mtu_discover(worker_p worker, uv_os_fd_t fd);
+static bool worker_sources_open(worker_p worker, int flags);
+static void worker_sources_configure(worker_p worker);
+static void worker_zerocopy_init(worker_p worker);
+static void worker_zerocopy_drain(worker_p worker);
+#endif /*PLATFORM_LINUX*/
+static size_t worker_count_datagrams(worker_p worker, size_t size);
+static void worker_fragments_init(worker_p worker);
+static size_t worker_count_fragments(worker_p worker, size_t size);
+static void worker_schedule_send(worker_p worker);
+static bool worker_wait_rate(worker_p worker);
+static bool worker_wait_gap(worker_p worker);
+static void worker_advance_gap(worker_p worker);
+static bool worker_wait_until(worker_p worker, uint64_t due_ns);
 static void worker_request_send_completed(uv_udp_send_t *req, int status);
+static void worker_reply_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf);
+static void worker_reply_received(uv_udp_t *socket, ssize_t nread, const uv_buf_t *buf, const struct sockaddr *addr,
+                                  unsigned int flags);
+static void worker_record_latency(histogram_t *histogram, uint64_t from_ns, uint64_t to_ns, size_t count);
 
 worker_p worker_create_in_loop(uv_loop_t *loop, unsigned int index) {
   worker_p worker = (worker_p)calloc(1, sizeof(*worker));
@@ -83,6 +332,7 @@ worker_p worker_create_in_loop(uv_loop_t *loop, unsigned int index) {
   worker->threaded = false;
   worker->index = index;
   worker->state = worker_state_unknown;
+  worker->stats = stats_get(index);
   worker->loop = loop;
 
   if (!worker_init(worker)) {
@@ -105,6 +355,7 @@ worker_p worker_create_in_thread(unsigned int index) {
   worker->threaded = true;
   worker->index = index;
   worker->state = worker_state_unknown;
+  worker->stats = stats_get(index);
 
   int err = uv_mutex_init(&worker->mutex);
   if (0 != err) {
@@ -159,7 +410,11 @@ void worker_destroy(worker_p worker) {
   if (!worker->threaded) {
     uv_async_send(&worker->term);
   } else {
-    uv_async_send(&worker->term);
+    if (g_arg_is_busy_poll) {
+      custom_atomic_store(&worker->is_stopping, true);
+    } else {
+      uv_async_send(&worker->term);
+    }
 
     uv_thread_join(&worker->thread);
     uv_cond_destroy(&worker->cond);
@@ -182,12 +437,28 @@ static void worker_release(worker_p worker) {
   assert(NULL != worker);
 
   if (1 == custom_atomic_fetch_sub(&worker->refs_counter, 1)) {
-    free(worker->datagram);
+#if defined(PLATFORM_LINUX)
+    free(worker->batch_messages);
+    free(worker->batch_iovecs);
+    free(worker->batch_sockaddrs);
+    free(worker->batch_headers);
+    free(worker->ring_free);
+    free(worker->ring_submit_ns);
+    free(worker->packet_frames);
+    free(worker->sink_buffers);
+    free(worker->source_fds);
+#endif /*PLATFORM_LINUX*/
+    free(worker->sources);
+    free(worker->header_sequences);
+    free(worker->slots);
+    free(worker->slots_free);
+    free(worker->connections);
+    payload_pool_term(&worker->payload);
     free(worker);
   }
 }
 
-static bool worker_init(worker_p worker) {
+static bool worker_prepare(worker_p worker) {
   assert(NULL != worker);
 
 #if defined(PLATFORM_WINDOWS)
@@ -214,10 +485,118 @@ static bool worker_init(worker_p worker) {
   }
 #endif /*PLATFORM_WINDOWS*/
 
-  worker->datagram_max_size = g_arg_size_max;
-  worker->datagram = (uint8_t *)malloc(worker->datagram_max_size);
-  if (NULL == worker->datagram) {
-    logger_print_error("#%d: malloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+#if defined(PLATFORM_LINUX)
+  if (g_arg_cpus_count > 0) {
+    // the thread is pinned before anything is allocated, so first touch places the memory near the CPU
+    unsigned int cpu = g_arg_cpus[(worker->index - 1) % g_arg_cpus_count];
+    int err = affinity_set_cpu(cpu);
+    if (err) {
+      logger_print_error("#%d: sched_setaffinity(%u) failed: %s\n", worker->index, cpu, uv_strerror(err));
+    } else {
+      logger_print_trace("#%d: Use CPU %u\n", worker->index, cpu);
+    }
+
+    int node = g_arg_is_numa ? affinity_cpu_node(cpu) : -1;
+    if (node >= 0) {
+      err = affinity_set_memory_node(node);
+      if (err) {
+        logger_print_error("#%d: set_mempolicy(%d) failed: %s\n", worker->index, node, uv_strerror(err));
+      } else {
+        logger_print_trace("#%d: Use memory of node %d\n", worker->index, node);
+      }
+    }
+  }
+#endif /*PLATFORM_LINUX*/
+
+  // with --seed each worker has its own stream, so runs with the same arguments send the same data
+  random_seed(g_arg_is_seeded ? g_arg_seed : uv_hrtime(), (uint64_t)worker->index);
+
+  if (g_arg_is_sweep) {
+    // each worker visits every g_arg_workers_count-th position of the permutation
+    worker->sweep_position = (worker->index - 1) % g_sweep.size;
+  }
+
+  worker->gso_segments = 1;
+  worker_fragments_init(worker);
+
+  // with UDP GSO one send contains g_arg_gso datagrams of the same size
+  size_t pool_size = (size_t)g_arg_size_max * g_arg_gso * 4;
+  if (pool_size < PAYLOAD_POOL_SIZE) {
+    pool_size = PAYLOAD_POOL_SIZE;
+  }
+
+  int err = payload_pool_init(&worker->payload, pool_size);
+  if (err) {
+    logger_print_error("#%d: malloc failed: %s\n", worker->index, uv_strerror(err));
+    return false;
+  }
+
+  worker->slots = (worker_slot_t *)calloc(g_arg_depth, sizeof(*worker->slots));
+  worker->slots_free = (worker_slot_p *)calloc(g_arg_depth, sizeof(*worker->slots_free));
+  if (NULL == worker->slots || NULL == worker->slots_free) {
+    logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+    return false;
+  }
+
+  unsigned int slot_index = 0;
+  for (slot_index = 0; slot_index < (unsigned int)g_arg_depth; ++slot_index) {
+    worker_slot_p slot = &worker->slots[slot_index];
+    slot->worker = worker;
+
+    worker->slots_free[worker->slots_free_count++] = slot;
+  }
+
+  // the sockets are opened on first use, so a fixed destination gets only one of them
+  if (g_arg_connect > 0) {
+    worker->connections = (worker_connection_t *)calloc(g_arg_connect, sizeof(*worker->connections));
+    if (NULL == worker->connections) {
+      logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+      return false;
+    }
+  }
+
+  worker->header_sequences = (uint64_t *)calloc(g_arg_source_ports, sizeof(*worker->header_sequences));
+  if (NULL == worker->header_sequences) {
+    logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+    return false;
+  }
+
+  // io_uring and the busy-poll loop open plain sockets instead
+  if (g_arg_source_ports > 1 && engine_libuv == g_arg_engine && !g_arg_is_busy_poll) {
+    worker->sources = (uv_udp_t *)calloc((size_t)g_arg_source_ports - 1, sizeof(*worker->sources));
+    if (NULL == worker->sources) {
+      logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+      return false;
+    }
+  }
+
+#if defined(PLATFORM_LINUX)
+  worker->source_fds = (uv_os_fd_t *)calloc(g_arg_source_ports, sizeof(*worker->source_fds));
+  if (NULL == worker->source_fds) {
+    logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+    return false;
+  }
+
+  if (g_arg_batch > 1 || engine_io_uring == g_arg_engine || g_arg_is_busy_poll || g_arg_is_sink) {
+    worker->batch_messages = (struct mmsghdr *)calloc(g_arg_batch, sizeof(*worker->batch_messages));
+    worker->batch_iovecs = (struct iovec *)calloc(2 * (size_t)g_arg_batch, sizeof(*worker->batch_iovecs));
+    worker->batch_sockaddrs = (sockaddr_any *)calloc(g_arg_batch, sizeof(*worker->batch_sockaddrs));
+    worker->batch_headers = (uint8_t *)calloc(g_arg_batch, PROBE_HEADER_SIZE);
+    if (NULL == worker->batch_messages || NULL == worker->batch_iovecs || NULL == worker->batch_sockaddrs ||
+        NULL == worker->batch_headers) {
+      logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+      return false;
+    }
+  }
+#endif /*PLATFORM_LINUX*/
+
+  return true;
+}
+
+static bool worker_init(worker_p worker) {
+  assert(NULL != worker);
+
+  if (!worker_prepare(worker)) {
     return false;
   }
 
@@ -245,9 +624,10 @@ static bool worker_init(worker_p worker) {
   }
   uv_handle_set_data((uv_handle_t *)&worker->wait, worker_retain(worker));
 
-  err = uv_udp_init(worker->loop, &worker->socket);
+  // the socket is created right away, so the batch engine can use its descriptor
+  err = uv_udp_init_ex(worker->loop, &worker->socket, g_arg_is_ipv4 ? AF_INET : AF_INET6);
   if (err) {
-    logger_print_error("#%d: uv_udp_init failed: %s\n", worker->index, uv_strerror(err));
+    logger_print_error("#%d: uv_udp_init_ex failed: %s\n", worker->index, uv_strerror(err));
     uv_close((uv_handle_t *)&worker->term, worker_handle_closed);
     uv_close((uv_handle_t *)&worker->send, worker_handle_closed);
     uv_close((uv_handle_t *)&worker->wait, worker_handle_closed);
@@ -255,7 +635,56 @@ static bool worker_init(worker_p worker) {
   }
   uv_handle_set_data((uv_handle_t *)&worker->socket, worker_retain(worker));
 
-  uv_async_send(&worker->send);
+  if (!worker_sources_init(worker)) {
+    uv_close((uv_handle_t *)&worker->term, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->send, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->wait, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->socket, worker_handle_closed);
+    worker_sources_close(worker);
+    return false;
+  }
+
+#if defined(PLATFORM_LINUX)
+  if (engine_io_uring == g_arg_engine && !worker_uring_init(worker)) {
+    uv_close((uv_handle_t *)&worker->term, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->send, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->wait, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->socket, worker_handle_closed);
+    worker_sources_close(worker);
+    return false;
+  }
+
+  if (engine_packet == g_arg_engine && !worker_packet_init(worker)) {
+    uv_close((uv_handle_t *)&worker->term, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->send, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->wait, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->socket, worker_handle_closed);
+    worker_sources_close(worker);
+    return false;
+  }
+
+  if (g_arg_is_sink && !worker_sink_init(worker)) {
+    uv_close((uv_handle_t *)&worker->term, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->send, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->wait, worker_handle_closed);
+    uv_close((uv_handle_t *)&worker->socket, worker_handle_closed);
+    worker_sources_close(worker);
+    return false;
+  }
+
+  worker_sources_configure(worker);
+
+  if (g_arg_gso > 1) {
+    worker_set_gso(worker, (unsigned int)g_arg_gso);
+  }
+
+  worker_pace_init(worker);
+#endif /*PLATFORM_LINUX*/
+
+  // the sink only receives, its send handle is never signalled
+  if (!g_arg_is_sink) {
+    uv_async_send(&worker->send);
+  }
 
   return true;
 }
@@ -272,19 +701,52 @@ static void worker_async_term(uv_async_t *async) {
 
   worker_set_state(worker, worker_state_stopped);
 
-  uv_cancel((uv_req_t *)&worker->send_request);
-  uv_cancel((uv_req_t *)&worker->addr_request);
+  unsigned int slot_index = 0;
+  for (slot_index = 0; slot_index < (unsigned int)g_arg_depth; ++slot_index) {
+    uv_cancel((uv_req_t *)&worker->slots[slot_index].send_request);
+    uv_cancel((uv_req_t *)&worker->slots[slot_index].addr_request);
+  }
 
   uv_close((uv_handle_t *)&worker->term, worker_handle_closed);
   uv_close((uv_handle_t *)&worker->send, worker_handle_closed);
   uv_close((uv_handle_t *)&worker->wait, worker_handle_closed);
   uv_close((uv_handle_t *)&worker->socket, worker_handle_closed);
+  worker_sources_close(worker);
+
+  int connection_index = 0;
+  for (connection_index = 0; connection_index < g_arg_connect; ++connection_index) {
+    worker_connection_p connection = &worker->connections[connection_index];
+    if (connection->is_open) {
+      uv_close((uv_handle_t *)&connection->socket, worker_handle_closed);
+    }
+  }
+
+#if defined(PLATFORM_LINUX)
+  if (engine_io_uring == g_arg_engine) {
+    worker_uring_term(worker);
+  } else if (engine_packet == g_arg_engine) {
+    worker_packet_term(worker);
+  }
+
+  if (g_arg_is_sink) {
+    worker_sink_term(worker);
+  }
+
+  worker_pace_term(worker);
+#endif /*PLATFORM_LINUX*/
 }
 
 static void worker_thread_proc(worker_p worker) {
   assert(NULL != worker);
   assert(0 != worker->index);
 
+#if defined(PLATFORM_LINUX)
+  if (g_arg_is_busy_poll) {
+    worker_busy_proc(worker);
+    return;
+  }
+#endif /*PLATFORM_LINUX*/
+
   worker_retain(worker);
 
   uv_loop_t loop;
@@ -406,40 +868,101 @@ static void worker_async_send(uv_async_t *async) {
   worker_p worker = (worker_p)uv_handle_get_data((uv_handle_t *)async);
   assert(NULL != worker);
 
-  if (worker_is_stopped(worker)) {
+  if (worker_is_stopped(worker) || worker_wait_rate(worker) || worker_wait_gap(worker)) {
+    return;
+  }
+
+  // a paced send is due at its deadline, so a late wake-up shows in the histogram, other sends are due now
+  worker->scheduled_ns = (0 != worker->pace_due_ns) ? worker->pace_due_ns : uv_hrtime();
+  worker->pace_due_ns = 0;
+
+#if defined(PLATFORM_LINUX)
+  if (engine_io_uring == g_arg_engine) {
+    worker_uring_send(worker);
+    return;
+  } else if (engine_packet == g_arg_engine && g_arg_is_numeric) {
+    worker_packet_send(worker, NULL);
     return;
+  } else if (g_arg_batch > 1) {
+    worker_send_batch(worker);
+    return;
+  }
+#endif /*PLATFORM_LINUX*/
+
+  // every free slot starts a send, completions refill the pipeline
+  while (worker->slots_free_count > 0) {
+    worker_slot_p slot = worker_take_slot(worker);
+    slot->scheduled_ns = worker->scheduled_ns;
+
+    if (g_arg_is_numeric) {
+      worker_next_destination(worker, &slot->sockaddr);
+
+      if (g_logger_level >= LOGGER_LEVEL_TRACE) {
+        address_format(&slot->sockaddr, slot->address, sizeof(slot->address));
+      }
+
+      worker_send_datagram(slot);
+    } else {
+      worker_resolve_destination(slot);
+    }
+
+    // with --gap every send has its own time
+    if (0 != g_arg_gap_ns) {
+      break;
+    }
   }
+}
+
+static worker_slot_p worker_take_slot(worker_p worker) {
+  assert(NULL != worker);
+  assert(worker->slots_free_count > 0);
+
+  return worker->slots_free[--worker->slots_free_count];
+}
+
+static void worker_return_slot(worker_p worker, worker_slot_p slot) {
+  assert(NULL != worker);
+  assert(NULL != slot);
+  assert(worker->slots_free_count < (unsigned int)g_arg_depth);
+
+  worker->slots_free[worker->slots_free_count++] = slot;
+}
+
+static void worker_resolve_destination(worker_slot_p slot) {
+  assert(NULL != slot);
+
+  worker_p worker = slot->worker;
+  assert(NULL != worker);
 
-  worker->address[0] = 0;
+  int port = (g_arg_port_min == g_arg_port_max) ? (g_arg_port_min)
+                                                : (g_arg_port_min + random_next() % (g_arg_port_max - g_arg_port_min + 1));
+
+  slot->address[0] = 0;
   const char *address = g_arg_address;
   while (*address) {
     const char *ptr = strchr(address, '*');
     if (!ptr) {
-      strcat_s(worker->address, sizeof(worker->address), address);
+      strcat_s(slot->address, sizeof(slot->address), address);
       break;
     }
 
     if (address != ptr) {
-      strncat_s(worker->address, sizeof(worker->address), address, ptr - address);
+      strncat_s(slot->address, sizeof(slot->address), address, ptr - address);
     }
 
     char buffer[10];
     if (g_arg_is_ipv4) {
-      sprintf_s(buffer, countof(buffer), "%d", random() % 256);
+      sprintf_s(buffer, countof(buffer), "%d", random_next() % 256);
     } else {
-      sprintf_s(buffer, countof(buffer), "%04x", random() % 65536);
+      sprintf_s(buffer, countof(buffer), "%04x", random_next() % 65536);
     }
 
-    strcat_s(worker->address, sizeof(worker->address), buffer);
+    strcat_s(slot->address, sizeof(slot->address), buffer);
 
     address = ptr + 1;
   }
 
-  if (g_arg_port_min == g_arg_port_max) {
-    sprintf_s(worker->port, countof(worker->port), "%d", g_arg_port_min);
-  } else {
-    sprintf_s(worker->port, countof(worker->port), "%d", g_arg_port_min + random() % (g_arg_port_max - g_arg_port_min + 1));
-  }
+  sprintf_s(slot->port, countof(slot->port), "%d", port);
 
   struct addrinfo hints = {0};
   hints.ai_family = g_arg_is_ipv4 ? AF_INET : AF_INET6;
@@ -447,99 +970,1902 @@ static void worker_async_send(uv_async_t *async) {
   hints.ai_flags = AI_CANONNAME;
 
   int err =
-      uv_getaddrinfo(worker->loop, &worker->addr_request, worker_request_addr_completed, worker->address, worker->port, &hints);
+      uv_getaddrinfo(worker->loop, &slot->addr_request, worker_request_addr_completed, slot->address, slot->port, &hints);
   if (err) {
-    logger_print_error("#%d: uv_getaddrinfo(%s, %s) failed: %s\n", worker->index, worker->address, worker->port,
+    logger_print_error("#%d: uv_getaddrinfo(%s, %s) failed: %s\n", worker->index, slot->address, slot->port,
                        uv_strerror(err));
     return;
   }
 
-  uv_req_set_data((uv_req_t *)&worker->addr_request, worker_retain(worker));
+  uv_req_set_data((uv_req_t *)&slot->addr_request, slot);
+  worker_retain(worker);
+
+  stats_counter_add(&worker->stats->sent_inflight, 1);
 }
 
 static void worker_request_addr_completed(uv_getaddrinfo_t *req, int status, struct addrinfo *res) {
   assert(NULL != req);
 
-  worker_p worker = (worker_p)uv_req_get_data((uv_req_t *)req);
+  worker_slot_p slot = (worker_slot_p)uv_req_get_data((uv_req_t *)req);
+  assert(NULL != slot);
+
+  worker_p worker = slot->worker;
+  assert(NULL != worker);
+
+  stats_counter_sub(&worker->stats->sent_inflight, 1);
 
   if (worker_is_stopped(worker) || UV_ECANCELED == status) {
     worker_release(worker);
     return;
   }
 
+  // the slot is not reused after an error, so the worker stops when all slots fail
   if (status) {
-    logger_print_error("#%d: uv_getaddrinfo(%s, %s) failed: %s\n", worker->index, worker->address, worker->port,
+    logger_print_error("#%d: uv_getaddrinfo(%s, %s) failed: %s\n", worker->index, slot->address, slot->port,
                        uv_strerror(status));
     worker_release(worker);
     return;
   } else if (NULL == res) {
-    logger_print_error("#%d: uv_getaddrinfo(%s, %s) failed: %s\n", worker->index, worker->address, worker->port,
+    logger_print_error("#%d: uv_getaddrinfo(%s, %s) failed: %s\n", worker->index, slot->address, slot->port,
                        uv_strerror(UV_EINVAL));
     worker_release(worker);
     return;
   }
 
-  memcpy_s(&worker->sockaddr, sizeof(worker->sockaddr), res->ai_addr, res->ai_addrlen);
+  memcpy_s(&slot->sockaddr, sizeof(slot->sockaddr), res->ai_addr, res->ai_addrlen);
 
   uv_freeaddrinfo(res);
 
-  int size = (g_arg_size_min == g_arg_size_max) ? (g_arg_size_min)
-                                                : (g_arg_size_min + random() % (g_arg_size_max - g_arg_size_min + 1));
+  strcat_s(slot->address, sizeof(slot->address), " ");
+  strcat_s(slot->address, sizeof(slot->address), slot->port);
 
-  int index = 0;
-  for (index = 0; index < size; ++index) {
-    worker->datagram[index] = random() % 256;
+  worker_send_datagram(slot);
+
+  worker_release(worker);
+}
+
+static void worker_next_destination(worker_p worker, sockaddr_any *sockaddr) {
+  assert(NULL != worker);
+  assert(NULL != sockaddr);
+  assert(g_arg_is_numeric);
+
+  if (g_arg_is_sweep) {
+    sweep_destination(&g_sweep, worker->sweep_position, sockaddr);
+
+    worker->sweep_position += g_arg_workers_count;
+    if (worker->sweep_position >= g_sweep.size) {
+      ++worker->sweep_passes;
+      logger_print_info("#%d: Sweep pass %" PRIu64 " completed\n", worker->index, worker->sweep_passes);
+
+      worker->sweep_position = (worker->index - 1) % g_sweep.size;
+    }
+  } else {
+    int port = (g_arg_port_min == g_arg_port_max) ? (g_arg_port_min)
+                                                  : (g_arg_port_min + random_next() % (g_arg_port_max - g_arg_port_min + 1));
+
+    address_range_random(&g_arg_address_range, port, sockaddr);
+  }
+}
+
+static size_t worker_next_size(worker_p worker) {
+  assert(NULL != worker);
+
+  int size = 0;
+  if (0 != g_size_profile.count) {
+    unsigned int entry = profile_next(&g_size_profile);
+    stats_counter_add(&worker->stats->profile_counts[entry], worker->gso_segments);
+    size = g_size_profile.sizes[entry];
+  } else {
+    size = (g_arg_size_min == g_arg_size_max) ? (g_arg_size_min)
+                                              : (g_arg_size_min + random_next() % (g_arg_size_max - g_arg_size_min + 1));
   }
 
-  worker->buf.base = (char *)worker->datagram;
-  worker->buf.len = size;
+  // all datagrams have the same size if UDP GSO is enabled
+  return (size_t)size * worker->gso_segments;
+}
+
+static size_t worker_next_payload(worker_p worker, uint8_t **payload) {
+  assert(NULL != worker);
+  assert(NULL != payload);
 
-  logger_print_trace("#%d: Sending %d bytes to %s %s\n", worker->index, worker->buf.len, worker->address, worker->port);
+  size_t size = worker_next_size(worker);
+  *payload = payload_pool_slice(&worker->payload, size);
 
-  int err = uv_udp_send(&worker->send_request, &worker->socket, &worker->buf, 1, &worker->sockaddr.addr,
-                        worker_request_send_completed);
-  if (err) {
-    logger_print_error("#%d: uv_udp_send(%s, %s) failed: %s\n", worker->index, worker->address, worker->port, uv_strerror(err));
-    worker_release(worker);
-    return;
+  // a part of the pool is generated again, so the same slices do not repeat forever
+  if (g_arg_payload_refresh > 0) {
+    payload_pool_refresh(&worker->payload, size * g_arg_payload_refresh / 100);
   }
 
-  uv_req_set_data((uv_req_t *)&worker->send_request, worker_retain(worker));
+  return size;
+}
 
-  worker_release(worker);
+static size_t worker_next_datagram(worker_p worker, uint8_t *header, uint64_t *sequence, uint64_t time_ns,
+                                   uint8_t **payload, size_t *payload_size) {
+  assert(NULL != worker);
+  assert(NULL != header);
+  assert(NULL != sequence);
+  assert(NULL != payload);
+  assert(NULL != payload_size);
+
+  size_t size = worker_next_payload(worker, payload);
+  *payload_size = size;
+
+  // the header replaces the beginning of the payload, so the datagram keeps its size
+  if (g_arg_is_header) {
+    probe_write(header, worker->index, (*sequence)++, time_ns);
+    *payload_size -= PROBE_HEADER_SIZE;
+  }
+
+  return size;
 }
 
-static void worker_request_send_completed(uv_udp_send_t *req, int status) {
-  assert(NULL != req);
+static void worker_set_bufs(worker_slot_p slot, uint8_t *payload, size_t payload_size) {
+  assert(NULL != slot);
+  assert(NULL != payload);
+
+  slot->bufs_count = 0;
+  if (g_arg_is_header) {
+    slot->bufs[slot->bufs_count++] = uv_buf_init((char *)slot->header, PROBE_HEADER_SIZE);
+  }
+
+  slot->bufs[slot->bufs_count++] = uv_buf_init((char *)payload, (unsigned int)payload_size);
+}
 
-  worker_p worker = (worker_p)uv_req_get_data((uv_req_t *)req);
+static size_t worker_count_datagrams(worker_p worker, size_t size) {
   assert(NULL != worker);
 
-  if (worker_is_stopped(worker) || UV_ECANCELED == status) {
-    worker_release(worker);
+  if (1 == worker->gso_segments) {
+    return 1;
+  }
+
+  return (size + g_arg_size_min - 1) / g_arg_size_min;
+}
+
+static void worker_fragments_init(worker_p worker) {
+  assert(NULL != worker);
+
+  // the MTU of the route toward the base address is used for all destinations
+  int mtu = DEFAULT_MTU;
+
+#if defined(PLATFORM_LINUX)
+  if (g_arg_is_numeric) {
+    sockaddr_any sockaddr = g_arg_address_range.base;
+    if (g_arg_is_ipv4) {
+      sockaddr.addr4.sin_port = htons((uint16_t)g_arg_port_min);
+    } else {
+      sockaddr.addr6.sin6_port = htons((uint16_t)g_arg_port_min);
+    }
+
+    // connecting a UDP socket only looks up the route, nothing is sent
+    int fd = socket(g_arg_is_ipv4 ? AF_INET : AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+      int value = 0;
+      socklen_t value_length = sizeof(value);
+      if (0 == connect(fd, &sockaddr.addr, g_arg_is_ipv4 ? sizeof(sockaddr.addr4) : sizeof(sockaddr.addr6)) &&
+          0 == getsockopt(fd, g_arg_is_ipv4 ? IPPROTO_IP : IPPROTO_IPV6, g_arg_is_ipv4 ? IP_MTU : IPV6_MTU, &value,
+                          &value_length)) {
+        mtu = value;
+      }
+
+      close(fd);
+    }
+  }
+#endif /*PLATFORM_LINUX*/
+
+  // every fragment but the last one carries a multiple of 8 bytes, IPv6 fragments also have a fragment header
+  size_t ip_header_size = g_arg_is_ipv4 ? 20 : 40;
+  worker->fragment_threshold = (size_t)mtu - ip_header_size - UDP_HEADER_SIZE;
+  worker->fragment_step = ((size_t)mtu - ip_header_size - (g_arg_is_ipv4 ? 0 : 8)) & ~(size_t)7;
+
+  logger_print_trace("#%d: MTU %d, datagrams of more than %zu bytes are fragmented\n", worker->index, mtu,
+                     worker->fragment_threshold);
+}
+
+static size_t worker_count_fragments(worker_p worker, size_t size) {
+  assert(NULL != worker);
+
+  // segments of UDP GSO fit the MTU, and datagrams with DF are refused instead of fragmented
+  if (1 != worker->gso_segments || size <= worker->fragment_threshold || mtu_discover_do == g_arg_mtu_discover ||
+      mtu_discover_probe == g_arg_mtu_discover) {
+    return worker_count_datagrams(worker, size);
+  }
+
+  // the UDP header is a part of the first fragment
+  return (size + UDP_HEADER_SIZE + worker->fragment_step - 1) / worker->fragment_step;
+}
+
+static void worker_send_datagram(worker_slot_p slot) {
+  assert(NULL != slot);
+
+  worker_p worker = slot->worker;
+  assert(NULL != worker);
+
+#if defined(PLATFORM_LINUX)
+  if (engine_packet == g_arg_engine) {
+    // the resolved destination is written to the packet ring instead of the socket
+    worker_return_slot(worker, slot);
+    worker->scheduled_ns = slot->scheduled_ns;
+    worker_packet_send(worker, &slot->sockaddr);
     return;
   }
+#endif /*PLATFORM_LINUX*/
+
+  slot->submit_ns = uv_hrtime();
+
+  // the socket is taken before the header, which carries its sequence,
+  // a connected socket sends without an address, the sockets of the worker take the rest in turn
+  unsigned int source = worker_next_source(worker);
+  uv_udp_t *socket = worker_source_socket(worker, source);
+  const struct sockaddr *addr = &slot->sockaddr.addr;
+  uint64_t *sequence = &worker->header_sequences[source];
+
+  slot->connection = (NULL != worker->connections) ? worker_connection_take(worker, &slot->sockaddr) : NULL;
+  if (NULL != slot->connection) {
+    socket = &slot->connection->socket;
+    addr = NULL;
+    sequence = &slot->connection->header_sequence;
+  }
 
-  custom_atomic_fetch_add(&g_stats_sent_operations, 1);
-  custom_atomic_fetch_add(&g_stats_sent_bytes, worker->buf.len);
+  uint8_t *payload = NULL;
+  size_t payload_size = 0;
+  slot->size = worker_next_datagram(worker, slot->header, sequence, slot->submit_ns, &payload, &payload_size);
+  worker_set_bufs(slot, payload, payload_size);
 
-  if (0 == g_arg_timeout_ms) {
-    int err = uv_async_send(&worker->send);
-    if (err) {
-      logger_print_error("#%d: uv_async_send failed: %s\n", worker->index, uv_strerror(err));
-      worker_release(worker);
-      return;
+  logger_print_trace("#%d: Sending %zu bytes to %s\n", worker->index, slot->size, slot->address);
+
+  worker_record_latency(&worker->stats->schedule_latency, slot->scheduled_ns, slot->submit_ns, 1);
+
+  int err = uv_udp_send(&slot->send_request, socket, slot->bufs, slot->bufs_count, addr, worker_request_send_completed);
+  if (err) {
+    logger_print_error("#%d: uv_udp_send(%s) failed: %s\n", worker->index, slot->address, uv_strerror(err));
+    stats_counter_add(&worker->stats->sent_errors, 1);
+    return;
+  }
+
+  uv_req_set_data((uv_req_t *)&slot->send_request, slot);
+  worker_retain(worker);
+
+  if (NULL != slot->connection) {
+    ++slot->connection->inflight;
+  }
+
+  stats_counter_add(&worker->stats->sent_inflight, 1);
+}
+
+static worker_connection_p worker_connection_take(worker_p worker, const sockaddr_any *destination) {
+  assert(NULL != worker);
+  assert(NULL != destination);
+
+  // the cache is small, so a linear search is cheaper than a hash table, unused sockets are taken before connected ones
+  worker_connection_p victim = NULL;
+
+  int index = 0;
+  for (index = 0; index < g_arg_connect; ++index) {
+    worker_connection_p connection = &worker->connections[index];
+    if (connection->is_connected && address_equal(&connection->destination, destination)) {
+      connection->used = ++worker->connections_clock;
+      return connection;
     }
-  } else {
-    logger_print_trace("#%d: Waiting for %dms\n", worker->index, g_arg_timeout_ms);
 
-    int err = uv_timer_start(&worker->wait, worker_timer_timeout, g_arg_timeout_ms, 0);
-    if (err) {
-      logger_print_error("#%d: uv_timer_start failed: %s\n", worker->index, uv_strerror(err));
-      worker_release(worker);
-      return;
+    if (0 == connection->inflight &&
+        (NULL == victim || (victim->is_connected && (!connection->is_connected || connection->used < victim->used)))) {
+      victim = connection;
     }
   }
 
-  worker_release(worker);
+  // every socket is busy, the datagram is sent with its address
+  if (NULL == victim || !worker_connection_open(worker, victim, destination)) {
+    return NULL;
+  }
+
+  victim->used = ++worker->connections_clock;
+  return victim;
+}
+
+static bool worker_connection_open(worker_p worker, worker_connection_p connection, const sockaddr_any *destination) {
+  assert(NULL != worker);
+  assert(NULL != connection);
+  assert(NULL != destination);
+  assert(0 == connection->inflight);
+
+  int err = 0;
+  if (!connection->is_open) {
+    err = uv_udp_init_ex(worker->loop, &connection->socket, g_arg_is_ipv4 ? AF_INET : AF_INET6);
+    if (err) {
+      logger_print_error("#%d: uv_udp_init_ex failed: %s\n", worker->index, uv_strerror(err));
+      return false;
+    }
+    uv_handle_set_data((uv_handle_t *)&connection->socket, worker_retain(worker));
+    connection->is_open = true;
+
+#if defined(PLATFORM_LINUX)
+    uv_os_fd_t fd = -1;
+    if (mtu_discover_default != g_arg_mtu_discover && 0 == uv_fileno((uv_handle_t *)&connection->socket, &fd)) {
+      worker_set_mtu_discover(worker, fd);
+    }
+#endif /*PLATFORM_LINUX*/
+  } else if (connection->is_connected) {
+    // the least recently used destination is evicted, the socket is disconnected and connected again
+    connection->is_connected = false;
+    err = uv_udp_connect(&connection->socket, NULL);
+    if (err) {
+      logger_print_trace("#%d: uv_udp_connect(NULL) failed: %s\n", worker->index, uv_strerror(err));
+      return false;
+    }
+  }
+
+  err = uv_udp_connect(&connection->socket, &destination->addr);
+  if (err) {
+    logger_print_trace("#%d: uv_udp_connect failed: %s\n", worker->index, uv_strerror(err));
+    return false;
+  }
+
+  connection->destination = *destination;
+  connection->is_connected = true;
+  stats_counter_add(&worker->stats->sent_connects, 1);
+
+  return true;
+}
+
+static bool worker_sources_init(worker_p worker) {
+  assert(NULL != worker);
+
+  // other engines send from their own sockets, only the libuv engine binds its handles
+  unsigned int count = (NULL != worker->sources) ? (unsigned int)g_arg_source_ports : 1;
+  unsigned int index = 0;
+  for (index = 0; index < count; ++index) {
+    uv_udp_t *socket = worker_source_socket(worker, index);
+
+    int err = 0;
+    if (0 != index) {
+      err = uv_udp_init_ex(worker->loop, socket, g_arg_is_ipv4 ? AF_INET : AF_INET6);
+      if (err) {
+        logger_print_error("#%d: uv_udp_init_ex failed: %s\n", worker->index, uv_strerror(err));
+        return false;
+      }
+      uv_handle_set_data((uv_handle_t *)socket, worker_retain(worker));
+      ++worker->sources_count;
+    }
+
+    sockaddr_any sockaddr;
+    if (engine_libuv == g_arg_engine && worker_source_address(worker, index, &sockaddr)) {
+      char address[256] = {0};
+      address_format(&sockaddr, address, sizeof(address));
+
+      err = uv_udp_bind(socket, &sockaddr.addr, 0);
+      if (err) {
+        logger_print_error("#%d: uv_udp_bind(%s) failed: %s\n", worker->index, address, uv_strerror(err));
+        return false;
+      }
+
+      int length = (int)sizeof(sockaddr);
+      if (0 == uv_udp_getsockname(socket, &sockaddr.addr, &length)) {
+        address_format(&sockaddr, address, sizeof(address));
+      }
+      logger_print_trace("#%d: Socket %u is bound to %s\n", worker->index, index, address);
+    }
+
+    if (0 != g_arg_sndbuf) {
+      int value = g_arg_sndbuf;
+      err = uv_send_buffer_size((uv_handle_t *)socket, &value);
+      if (err) {
+        logger_print_error("#%d: uv_send_buffer_size failed: %s, the system size is used\n", worker->index,
+                           uv_strerror(err));
+      }
+    }
+
+    // an unbound socket is bound to a random port before the first send, replies come back to it
+    if (g_arg_is_rtt) {
+      err = uv_udp_recv_start(socket, worker_reply_alloc, worker_reply_received);
+      if (err) {
+        logger_print_error("#%d: uv_udp_recv_start failed: %s\n", worker->index, uv_strerror(err));
+        return false;
+      }
+    }
+
+#if defined(PLATFORM_LINUX)
+    err = uv_fileno((uv_handle_t *)socket, &worker->source_fds[index]);
+    if (err) {
+      logger_print_error("#%d: uv_fileno failed: %s\n", worker->index, uv_strerror(err));
+      return false;
+    }
+#endif /*PLATFORM_LINUX*/
+  }
+
+#if defined(PLATFORM_LINUX)
+  worker->fd = worker->source_fds[0];
+#endif /*PLATFORM_LINUX*/
+
+  return true;
+}
+
+static void worker_sources_close(worker_p worker) {
+  assert(NULL != worker);
+
+  unsigned int index = 0;
+  for (index = 0; index < worker->sources_count; ++index) {
+    uv_close((uv_handle_t *)&worker->sources[index], worker_handle_closed);
+  }
+
+  worker->sources_count = 0;
+}
+
+static bool worker_source_address(worker_p worker, unsigned int index, sockaddr_any *sockaddr) {
+  assert(NULL != worker);
+  assert(NULL != sockaddr);
+
+  // sockets of all workers take consecutive addresses of the range, it wraps around if it is shorter
+  if (NULL != g_arg_bind) {
+    uint64_t position = (uint64_t)(worker->index - 1) * (uint64_t)g_arg_source_ports + index;
+    address_range_at(&g_arg_bind_range, position, 0, sockaddr);
+    return true;
+  }
+
+  // a single socket is bound by the first send, more of them need distinct ports right away
+  if (g_arg_source_ports > 1) {
+    memset(sockaddr, 0, sizeof(*sockaddr));
+    sockaddr->addr.sa_family = g_arg_is_ipv4 ? AF_INET : AF_INET6;
+    return true;
+  }
+
+  return false;
+}
+
+static unsigned int worker_next_source(worker_p worker) {
+  assert(NULL != worker);
+
+  unsigned int index = worker->source_next;
+  worker->source_next = (index + 1 < (unsigned int)g_arg_source_ports) ? index + 1 : 0;
+  worker->source_index = index;
+
+#if defined(PLATFORM_LINUX)
+  worker->fd = worker->source_fds[index];
+#endif /*PLATFORM_LINUX*/
+
+  return index;
+}
+
+static uv_udp_t *worker_source_socket(worker_p worker, unsigned int index) {
+  assert(NULL != worker);
+
+  return (0 == index || NULL == worker->sources) ? &worker->socket : &worker->sources[index - 1];
+}
+
+#if defined(PLATFORM_LINUX)
+static void worker_fill_batch(worker_p worker, unsigned int count) {
+  assert(NULL != worker);
+
+  // the datagrams of a batch share the send time of their headers
+  uint64_t time_ns = g_arg_is_header ? uv_hrtime() : 0;
+
+  unsigned int index = 0;
+  for (index = 0; index < count; ++index) {
+    worker_fill_message(worker, index, time_ns);
+  }
+}
+
+static void worker_fill_message(worker_p worker, unsigned int index, uint64_t time_ns) {
+  assert(NULL != worker);
+
+  worker_next_destination(worker, &worker->batch_sockaddrs[index]);
+
+  uint8_t *header = worker->batch_headers + (size_t)index * PROBE_HEADER_SIZE;
+  uint8_t *payload = NULL;
+  size_t payload_size = 0;
+  worker_next_datagram(worker, header, &worker->header_sequences[worker->source_index], time_ns, &payload,
+                       &payload_size);
+
+  struct iovec *iovecs = &worker->batch_iovecs[2 * (size_t)index];
+  size_t iovecs_count = 0;
+  if (g_arg_is_header) {
+    iovecs[iovecs_count].iov_base = header;
+    iovecs[iovecs_count].iov_len = PROBE_HEADER_SIZE;
+    ++iovecs_count;
+  }
+
+  iovecs[iovecs_count].iov_base = payload;
+  iovecs[iovecs_count].iov_len = payload_size;
+  ++iovecs_count;
+
+  struct msghdr *message = &worker->batch_messages[index].msg_hdr;
+  message->msg_name = &worker->batch_sockaddrs[index];
+  message->msg_namelen = g_arg_is_ipv4 ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+  message->msg_iov = iovecs;
+  message->msg_iovlen = iovecs_count;
+}
+
+static size_t worker_message_size(worker_p worker, unsigned int index) {
+  assert(NULL != worker);
+
+  const struct msghdr *message = &worker->batch_messages[index].msg_hdr;
+
+  size_t size = 0;
+  size_t iovec_index = 0;
+  for (iovec_index = 0; iovec_index < message->msg_iovlen; ++iovec_index) {
+    size += message->msg_iov[iovec_index].iov_len;
+  }
+
+  return size;
+}
+
+static void worker_account_batch(worker_p worker, unsigned int offset, unsigned int sent) {
+  assert(NULL != worker);
+
+  size_t bytes = 0;
+  size_t datagrams = 0;
+  size_t fragments = 0;
+
+  unsigned int index = 0;
+  for (index = offset; index < offset + sent; ++index) {
+    size_t size = worker_message_size(worker, index);
+    bytes += size;
+    datagrams += worker_count_datagrams(worker, size);
+    fragments += worker_count_fragments(worker, size);
+  }
+
+  stats_counter_add(&worker->stats->sent_operations, datagrams);
+  stats_counter_add(&worker->stats->sent_fragments, fragments);
+  stats_counter_add(&worker->stats->sent_messages, sent);
+  stats_counter_add(&worker->stats->sent_bytes, bytes);
+}
+
+static void worker_send_batch(worker_p worker) {
+  assert(NULL != worker);
+
+  unsigned int count = (unsigned int)g_arg_batch;
+  unsigned int offset = worker->batch_offset;
+  uint64_t submit_ns = uv_hrtime();
+
+  if (0 == offset) {
+    // the whole batch leaves from one socket, the next batch takes the next one
+    worker->batch_source = worker_next_source(worker);
+    worker_fill_batch(worker, count);
+
+    submit_ns = uv_hrtime();
+    worker_record_latency(&worker->stats->schedule_latency, worker->scheduled_ns, submit_ns, count);
+  }
+
+  unsigned int source = worker->batch_source;
+  worker->batch_offset = 0;
+
+  int sent = sendmmsg(worker->fd, worker->batch_messages + offset, count - offset, worker->send_flags);
+  stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+  // the error is kept before the drain, which always ends with a failed recvmsg
+  int err = (sent < 0) ? uv_translate_sys_error(errno) : 0;
+  if (MSG_ZEROCOPY & worker->send_flags) {
+    worker_zerocopy_drain(worker);
+  }
+
+  if (sent < 0) {
+    if (worker_is_gso_refused(worker, err)) {
+      worker_schedule_send(worker);
+      return;
+    } else if (UV_EAGAIN != err) {
+      logger_print_error("#%d: sendmmsg failed: %s\n", worker->index, uv_strerror(err));
+      stats_counter_add(&worker->stats->sent_errors, 1);
+      return;
+    }
+
+    sent = 0;
+  }
+
+  // sendmmsg completes the sends before it returns
+  worker_account_batch(worker, offset, (unsigned int)sent);
+  worker_record_latency(&worker->stats->send_latency, submit_ns, uv_hrtime(), (size_t)sent);
+
+  logger_print_trace("#%d: Sent %d of %u datagrams\n", worker->index, sent, count - offset);
+
+  unsigned int index = offset + (unsigned int)sent;
+  if (index == count) {
+    worker_schedule_send(worker);
+    return;
+  }
+
+  // the socket buffer is full, libuv sends the first unsent datagram when the socket becomes writable
+  // and worker_request_send_completed continues with the rest of the batch
+  worker_slot_p slot = worker_take_slot(worker);
+  slot->sockaddr = worker->batch_sockaddrs[index];
+  slot->size = worker_message_size(worker, index);
+
+  // the header is copied, so the slot does not depend on the next batch
+  const struct msghdr *message = &worker->batch_messages[index].msg_hdr;
+  if (g_arg_is_header) {
+    memcpy(slot->header, worker->batch_headers + (size_t)index * PROBE_HEADER_SIZE, PROBE_HEADER_SIZE);
+  }
+
+  const struct iovec *payload = &message->msg_iov[message->msg_iovlen - 1];
+  worker_set_bufs(slot, (uint8_t *)payload->iov_base, payload->iov_len);
+  slot->scheduled_ns = worker->scheduled_ns;
+  slot->submit_ns = uv_hrtime();
+
+  if (g_logger_level >= LOGGER_LEVEL_TRACE) {
+    address_format(&slot->sockaddr, slot->address, sizeof(slot->address));
+  }
+
+  err = uv_udp_send(&slot->send_request, worker_source_socket(worker, source), slot->bufs, slot->bufs_count,
+                    &slot->sockaddr.addr, worker_request_send_completed);
+  if (err) {
+    logger_print_error("#%d: uv_udp_send(%s) failed: %s\n", worker->index, slot->address, uv_strerror(err));
+    stats_counter_add(&worker->stats->sent_errors, 1);
+    return;
+  }
+
+  uv_req_set_data((uv_req_t *)&slot->send_request, slot);
+  worker_retain(worker);
+
+  stats_counter_add(&worker->stats->sent_inflight, 1);
+
+  worker->batch_offset = (index + 1 < count) ? index + 1 : 0;
+}
+
+static void worker_set_gso(worker_p worker, unsigned int segments) {
+  assert(NULL != worker);
+
+  int gso_size = (segments > 1) ? g_arg_size_min : 0;
+  int index = 0;
+  for (index = 0; index < g_arg_source_ports; ++index) {
+    if (0 != setsockopt(worker->source_fds[index], SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size))) {
+      logger_print_error("#%d: setsockopt(UDP_SEGMENT) failed: %s, sending one datagram at once\n", worker->index,
+                         uv_strerror(uv_translate_sys_error(errno)));
+
+      // the sockets before this one already split datagrams, only they are reset
+      if (segments > 1) {
+        int disabled = 0;
+        while (index-- > 0) {
+          setsockopt(worker->source_fds[index], SOL_UDP, UDP_SEGMENT, &disabled, sizeof(disabled));
+        }
+
+        segments = 1;
+        break;
+      }
+    }
+  }
+
+  worker->gso_segments = segments;
+}
+
+static bool worker_is_gso_refused(worker_p worker, int err) {
+  assert(NULL != worker);
+
+  // the kernel returns EIO if the device cannot offload checksums and EINVAL if the route cannot use GSO
+  if (worker->gso_segments > 1 && (UV_EIO == err || UV_EINVAL == err)) {
+    logger_print_error("#%d: UDP GSO refused: %s, sending one datagram at once\n", worker->index, uv_strerror(err));
+    worker_set_gso(worker, 1);
+    return true;
+  }
+
+  return false;
+}
+
+static void worker_set_mtu_discover(worker_p worker, uv_os_fd_t fd) {
+  assert(NULL != worker);
+
+  int mode = 0;
+  switch (g_arg_mtu_discover) {
+  case mtu_discover_dont:
+    mode = g_arg_is_ipv4 ? IP_PMTUDISC_DONT : IPV6_PMTUDISC_DONT;
+    break;
+  case mtu_discover_do:
+    mode = g_arg_is_ipv4 ? IP_PMTUDISC_DO : IPV6_PMTUDISC_DO;
+    break;
+  case mtu_discover_probe:
+    mode = g_arg_is_ipv4 ? IP_PMTUDISC_PROBE : IPV6_PMTUDISC_PROBE;
+    break;
+  default:
+    mode = g_arg_is_ipv4 ? IP_PMTUDISC_WANT : IPV6_PMTUDISC_WANT;
+    break;
+  }
+
+  if (0 != setsockopt(fd, g_arg_is_ipv4 ? IPPROTO_IP : IPPROTO_IPV6,
+                      g_arg_is_ipv4 ? IP_MTU_DISCOVER : IPV6_MTU_DISCOVER, &mode, sizeof(mode))) {
+    logger_print_error("#%d: setsockopt(%s) failed: %s, the system mode is used\n", worker->index,
+                       g_arg_is_ipv4 ? "IP_MTU_DISCOVER" : "IPV6_MTU_DISCOVER", uv_strerror(uv_translate_sys_error(errno)));
+  }
+}
+
+static bool worker_sources_open(worker_p worker, int flags) {
+  assert(NULL != worker);
+
+  int index = 0;
+  for (index = 0; index < g_arg_source_ports; ++index) {
+    worker->source_fds[index] = -1;
+  }
+
+  for (index = 0; index < g_arg_source_ports; ++index) {
+    int fd = socket(g_arg_is_ipv4 ? AF_INET : AF_INET6, SOCK_DGRAM | SOCK_CLOEXEC | flags, 0);
+    if (fd < 0) {
+      logger_print_error("#%d: socket failed: %s\n", worker->index, uv_strerror(uv_translate_sys_error(errno)));
+      break;
+    }
+    worker->source_fds[index] = fd;
+
+    sockaddr_any sockaddr;
+    if (worker_source_address(worker, (unsigned int)index, &sockaddr)) {
+      char address[256] = {0};
+      address_format(&sockaddr, address, sizeof(address));
+
+      socklen_t length = g_arg_is_ipv4 ? sizeof(sockaddr.addr4) : sizeof(sockaddr.addr6);
+      if (0 != bind(fd, &sockaddr.addr, length)) {
+        logger_print_error("#%d: bind(%s) failed: %s\n", worker->index, address,
+                           uv_strerror(uv_translate_sys_error(errno)));
+        break;
+      }
+
+      length = sizeof(sockaddr);
+      if (0 == getsockname(fd, &sockaddr.addr, &length)) {
+        address_format(&sockaddr, address, sizeof(address));
+      }
+      logger_print_trace("#%d: Socket %d is bound to %s\n", worker->index, index, address);
+    }
+
+    if (0 != g_arg_sndbuf && 0 != setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &g_arg_sndbuf, sizeof(g_arg_sndbuf))) {
+      logger_print_error("#%d: setsockopt(SO_SNDBUF) failed: %s, the system size is used\n", worker->index,
+                         uv_strerror(uv_translate_sys_error(errno)));
+    }
+  }
+
+  if (index < g_arg_source_ports) {
+    for (index = 0; index < g_arg_source_ports; ++index) {
+      if (worker->source_fds[index] >= 0) {
+        close(worker->source_fds[index]);
+        worker->source_fds[index] = -1;
+      }
+    }
+    return false;
+  }
+
+  worker->fd = worker->source_fds[0];
+  return true;
+}
+
+static void worker_sources_configure(worker_p worker) {
+  assert(NULL != worker);
+
+  if (mtu_discover_default != g_arg_mtu_discover) {
+    int index = 0;
+    for (index = 0; index < g_arg_source_ports; ++index) {
+      worker_set_mtu_discover(worker, worker->source_fds[index]);
+    }
+  }
+
+  if (g_arg_is_zerocopy) {
+    worker_zerocopy_init(worker);
+  }
+}
+
+static void worker_zerocopy_init(worker_p worker) {
+  assert(NULL != worker);
+
+  // the flag is shared by all sockets, so every one of them has to accept it
+  int value = 1;
+  int index = 0;
+  for (index = 0; index < g_arg_source_ports; ++index) {
+    if (0 != setsockopt(worker->source_fds[index], SOL_SOCKET, SO_ZEROCOPY, &value, sizeof(value))) {
+      logger_print_error("#%d: setsockopt(SO_ZEROCOPY) failed: %s, sending with copies\n", worker->index,
+                         uv_strerror(uv_translate_sys_error(errno)));
+
+      // the sockets before this one accepted the option, it is cleared again, so all sockets send the same way
+      int disabled = 0;
+      while (index-- > 0) {
+        setsockopt(worker->source_fds[index], SOL_SOCKET, SO_ZEROCOPY, &disabled, sizeof(disabled));
+      }
+      return;
+    }
+  }
+
+  worker->send_flags |= MSG_ZEROCOPY;
+}
+
+static void worker_zerocopy_drain(worker_p worker) {
+  assert(NULL != worker);
+
+  // the kernel reports released pages on the error queue, the socket stops sending if the queue is never read
+  uint8_t control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in6))];
+
+  while (true) {
+    struct msghdr message = {0};
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(worker->fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      return;
+    }
+
+    struct cmsghdr *cmsg = NULL;
+    for (cmsg = CMSG_FIRSTHDR(&message); NULL != cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+      const struct sock_extended_err *error = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+      if (SO_EE_ORIGIN_ZEROCOPY != error->ee_origin) {
+        continue;
+      }
+
+      // loopback and devices without scatter-gather get a copy anyway
+      if ((SO_EE_CODE_ZEROCOPY_COPIED & error->ee_code) && !worker->is_zerocopy_copied) {
+        worker->is_zerocopy_copied = true;
+        logger_print_info("#%d: The kernel copies zero-copy sends, the device cannot send from user pages\n",
+                          worker->index);
+      }
+    }
+  }
+}
+
+static bool worker_uring_init(worker_p worker) {
+  assert(NULL != worker);
+
+  worker->ring_eventfd = -1;
+  worker->ring.fd = -1;
+
+  // io_uring waits for the sockets itself, so it gets blocking sockets instead of the libuv one
+  if (!worker_sources_open(worker, 0)) {
+    return false;
+  }
+
+  int err = uring_init(&worker->ring, (unsigned int)g_arg_batch);
+  if (err) {
+    logger_print_error("#%d: io_uring_setup failed: %s\n", worker->index, uv_strerror(err));
+    worker_uring_term(worker);
+    return false;
+  }
+
+  err = uring_register_files(&worker->ring, worker->source_fds, (unsigned int)g_arg_source_ports);
+  worker->ring_fixed_file = (0 == err);
+  if (err) {
+    logger_print_trace("#%d: io_uring_register(files) failed: %s\n", worker->index, uv_strerror(err));
+  }
+
+  worker->ring_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (worker->ring_eventfd < 0) {
+    logger_print_error("#%d: eventfd failed: %s\n", worker->index, uv_strerror(uv_translate_sys_error(errno)));
+    worker_uring_term(worker);
+    return false;
+  }
+
+  err = uring_register_eventfd(&worker->ring, worker->ring_eventfd);
+  if (err) {
+    logger_print_error("#%d: io_uring_register(eventfd) failed: %s\n", worker->index, uv_strerror(err));
+    worker_uring_term(worker);
+    return false;
+  }
+
+  worker->ring_free = (unsigned int *)calloc(g_arg_batch, sizeof(*worker->ring_free));
+  worker->ring_submit_ns = (uint64_t *)calloc(g_arg_batch, sizeof(*worker->ring_submit_ns));
+  if (NULL == worker->ring_free || NULL == worker->ring_submit_ns) {
+    logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+    worker_uring_term(worker);
+    return false;
+  }
+
+  unsigned int slot = 0;
+  for (slot = 0; slot < (unsigned int)g_arg_batch; ++slot) {
+    worker->ring_free[worker->ring_free_count++] = slot;
+  }
+
+  err = uv_poll_init(worker->loop, &worker->ring_poll, worker->ring_eventfd);
+  if (err) {
+    logger_print_error("#%d: uv_poll_init failed: %s\n", worker->index, uv_strerror(err));
+    worker_uring_term(worker);
+    return false;
+  }
+  uv_handle_set_data((uv_handle_t *)&worker->ring_poll, worker_retain(worker));
+
+  err = uv_poll_start(&worker->ring_poll, UV_READABLE, worker_uring_poll);
+  if (err) {
+    logger_print_error("#%d: uv_poll_start failed: %s\n", worker->index, uv_strerror(err));
+    uv_close((uv_handle_t *)&worker->ring_poll, worker_handle_closed);
+    worker_uring_term(worker);
+    return false;
+  }
+
+  logger_print_trace("#%d: io_uring with %u entries, %s file\n", worker->index, worker->ring.sq_entries,
+                     worker->ring_fixed_file ? "registered" : "regular");
+  return true;
+}
+
+static void worker_uring_term(worker_p worker) {
+  assert(NULL != worker);
+
+  if (uv_is_active((uv_handle_t *)&worker->ring_poll)) {
+    uv_close((uv_handle_t *)&worker->ring_poll, worker_handle_closed);
+  }
+
+  // the kernel uses the message headers and the buffers until the sends are completed
+  while (worker->ring_inflight > 0) {
+    if (uring_submit(&worker->ring, 1) < 0) {
+      break;
+    }
+
+    uring_reap(&worker->ring, worker_uring_discarded, worker);
+  }
+
+  if (worker->ring.fd >= 0) {
+    uring_term(&worker->ring);
+  }
+  if (worker->ring_eventfd >= 0) {
+    close(worker->ring_eventfd);
+    worker->ring_eventfd = -1;
+  }
+  int index = 0;
+  for (index = 0; index < g_arg_source_ports; ++index) {
+    if (worker->source_fds[index] >= 0) {
+      close(worker->source_fds[index]);
+      worker->source_fds[index] = -1;
+    }
+  }
+}
+
+static void worker_uring_send(worker_p worker) {
+  assert(NULL != worker);
+
+  if (0 == worker->ring_free_count) {
+    return;
+  }
+
+  // the sends of one submission share the send time of their headers
+  uint64_t time_ns = g_arg_is_header ? uv_hrtime() : 0;
+
+  unsigned int free_count = worker->ring_free_count;
+  while (worker->ring_free_count > 0) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&worker->ring);
+    if (NULL == sqe) {
+      break;
+    }
+
+    // every send takes the next socket, registered files are indexed in the same order
+    unsigned int source = worker_next_source(worker);
+
+    unsigned int slot = worker->ring_free[--worker->ring_free_count];
+    worker_fill_message(worker, slot, time_ns);
+
+    struct msghdr *header = &worker->batch_messages[slot].msg_hdr;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = worker->ring_fixed_file ? (int)source : worker->source_fds[source];
+    sqe->flags = worker->ring_fixed_file ? IOSQE_FIXED_FILE : 0;
+    sqe->addr = (uint64_t)(uintptr_t)header;
+    sqe->len = 1;
+    sqe->user_data = slot;
+
+    ++worker->ring_inflight;
+    stats_counter_add(&worker->stats->sent_inflight, 1);
+  }
+
+  // the taken slots are still stored after the free ones
+  uint64_t submit_ns = uv_hrtime();
+  unsigned int index = 0;
+  for (index = worker->ring_free_count; index < free_count; ++index) {
+    worker->ring_submit_ns[worker->ring_free[index]] = submit_ns;
+  }
+
+  worker_record_latency(&worker->stats->schedule_latency, worker->scheduled_ns, submit_ns,
+                        free_count - worker->ring_free_count);
+
+  int submitted = uring_submit(&worker->ring, 0);
+  stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+  if (submitted < 0) {
+    logger_print_error("#%d: io_uring_enter failed: %s\n", worker->index, uv_strerror(submitted));
+    stats_counter_add(&worker->stats->sent_errors, 1);
+    return;
+  }
+
+  logger_print_trace("#%d: Submitted %d sends, %u in flight\n", worker->index, submitted, worker->ring_inflight);
+}
+
+static void worker_uring_poll(uv_poll_t *poll, int status, int events) {
+  assert(NULL != poll);
+  (void)events;
+
+  worker_p worker = (worker_p)uv_handle_get_data((uv_handle_t *)poll);
+  assert(NULL != worker);
+
+  if (worker_is_stopped(worker)) {
+    return;
+  }
+
+  if (status) {
+    logger_print_error("#%d: uv_poll failed: %s\n", worker->index, uv_strerror(status));
+    return;
+  }
+
+  uint64_t value = 0;
+  while (read(worker->ring_eventfd, &value, sizeof(value)) < 0 && EINTR == errno) {
+  }
+
+  uring_reap(&worker->ring, worker_uring_completed, worker);
+
+  if (0 == worker->ring_free_count) {
+    return;
+  }
+
+  if (0 == g_arg_timeout_ms) {
+    worker_async_send(&worker->send);
+  } else if (!uv_is_active((uv_handle_t *)&worker->wait)) {
+    worker_schedule_send(worker);
+  }
+}
+
+static void worker_uring_completed(void *data, uint64_t user_data, int res) {
+  worker_p worker = (worker_p)data;
+  assert(NULL != worker);
+
+  --worker->ring_inflight;
+  stats_counter_sub(&worker->stats->sent_inflight, 1);
+
+  if (res >= 0) {
+    stats_counter_add(&worker->stats->sent_operations, worker_count_datagrams(worker, (size_t)res));
+    stats_counter_add(&worker->stats->sent_fragments, worker_count_fragments(worker, (size_t)res));
+    stats_counter_add(&worker->stats->sent_messages, 1);
+    stats_counter_add(&worker->stats->sent_bytes, (size_t)res);
+    worker_record_latency(&worker->stats->send_latency, worker->ring_submit_ns[user_data], uv_hrtime(), 1);
+  } else if (!worker_is_gso_refused(worker, uv_translate_sys_error(-res))) {
+    // the datagram is dropped even if the error is temporary, the slot gets a new one
+    stats_counter_add(&worker->stats->sent_errors, 1);
+
+    if (-EAGAIN != res && -ENOBUFS != res && -EINTR != res) {
+      // the slot is not reused, so the worker stops when all slots fail
+      logger_print_error("#%d: io_uring sendmsg failed: %s\n", worker->index,
+                         uv_strerror(uv_translate_sys_error(-res)));
+      return;
+    }
+  }
+
+  worker->ring_free[worker->ring_free_count++] = (unsigned int)user_data;
+}
+
+static void worker_uring_discarded(void *data, uint64_t user_data, int res) {
+  worker_p worker = (worker_p)data;
+  assert(NULL != worker);
+  (void)user_data;
+  (void)res;
+
+  --worker->ring_inflight;
+  stats_counter_sub(&worker->stats->sent_inflight, 1);
+}
+
+static bool worker_packet_init(worker_p worker) {
+  assert(NULL != worker);
+
+  worker->packet.fd = -1;
+
+  packet_interface_t iface;
+  int err = packet_interface_query(&iface, g_arg_interface, g_arg_is_ipv4);
+  if (err) {
+    logger_print_error("#%d: Cannot use interface %s: %s\n", worker->index, g_arg_interface, uv_strerror(err));
+    return false;
+  }
+
+  // frames bypass the IP layer, so nobody fragments a datagram which does not fit the MTU
+  worker->packet_headers_size = packet_headers_size(g_arg_is_ipv4);
+  if (worker->packet_headers_size + g_arg_size_max > PACKET_ETHER_HEADER_SIZE + iface.mtu) {
+    logger_print_error("#%d: Datagram of %d bytes does not fit MTU %u of %s\n", worker->index, g_arg_size_max, iface.mtu,
+                       g_arg_interface);
+    return false;
+  }
+
+  unsigned int frames_count = 4 * (unsigned int)g_arg_batch;
+  if (frames_count < MINIMAL_PACKET_FRAMES) {
+    frames_count = MINIMAL_PACKET_FRAMES;
+  }
+
+  err = packet_ring_init(&worker->packet, &iface, frames_count, worker->packet_headers_size + g_arg_size_max);
+  if (err) {
+    logger_print_error("#%d: PACKET_TX_RING setup failed: %s\n", worker->index, uv_strerror(err));
+    worker_packet_term(worker);
+    return false;
+  }
+
+  worker->packet_frames = (worker_frame_t *)calloc(worker->packet.frames_count, sizeof(*worker->packet_frames));
+  if (NULL == worker->packet_frames) {
+    logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+    worker_packet_term(worker);
+    return false;
+  }
+
+  // every worker uses its own source port, so receivers could tell the workers apart
+  sockaddr_any source = iface.address;
+  uint16_t source_port = htons((uint16_t)(49152 + random_next() % 16384));
+  if (g_arg_is_ipv4) {
+    source.addr4.sin_port = source_port;
+  } else {
+    source.addr6.sin6_port = source_port;
+  }
+
+  // the frames are built once, only destinations, sizes and checksums change for each send
+  unsigned int slot = 0;
+  for (slot = 0; slot < worker->packet.frames_count; ++slot) {
+    uint8_t *frame = packet_ring_frame(&worker->packet, slot);
+
+    packet_build_headers(frame, iface.mac, g_arg_destination_mac, &source);
+
+    uint8_t *payload = payload_pool_slice(&worker->payload, (size_t)g_arg_size_max);
+    memcpy(frame + worker->packet_headers_size, payload, (size_t)g_arg_size_max);
+  }
+
+  err = uv_poll_init(worker->loop, &worker->packet_poll, worker->packet.fd);
+  if (err) {
+    logger_print_error("#%d: uv_poll_init failed: %s\n", worker->index, uv_strerror(err));
+    worker_packet_term(worker);
+    return false;
+  }
+  uv_handle_set_data((uv_handle_t *)&worker->packet_poll, worker_retain(worker));
+
+  char source_str[64] = {0};
+  address_format(&source, source_str, sizeof(source_str));
+  logger_print_trace("#%d: Packet ring with %u frames of %u bytes, source %s\n", worker->index,
+                     worker->packet.frames_count, worker->packet.frame_size, source_str);
+  return true;
+}
+
+static void worker_packet_term(worker_p worker) {
+  assert(NULL != worker);
+
+  if (NULL != uv_handle_get_data((uv_handle_t *)&worker->packet_poll)) {
+    uv_close((uv_handle_t *)&worker->packet_poll, worker_handle_closed);
+  }
+
+  if (worker->packet.fd >= 0) {
+    packet_ring_term(&worker->packet);
+  }
+}
+
+static void worker_packet_send(worker_p worker, const sockaddr_any *destination) {
+  assert(NULL != worker);
+
+  // a resolved destination gets one frame, numeric destinations are sent in batches
+  unsigned int count = (NULL != destination) ? 1 : (unsigned int)g_arg_batch;
+
+  // the frames of one flush share the send time of their headers
+  uint64_t time_ns = g_arg_is_header ? uv_hrtime() : 0;
+  size_t header_size = g_arg_is_header ? PROBE_HEADER_SIZE : 0;
+
+  unsigned int index = 0;
+  for (index = 0; index < count; ++index) {
+    unsigned int slot = worker->packet.head;
+    uint8_t *frame = packet_ring_next(&worker->packet);
+    if (NULL == frame) {
+      break;
+    }
+
+    sockaddr_any sockaddr;
+    if (NULL == destination) {
+      worker_next_destination(worker, &sockaddr);
+    } else {
+      sockaddr = *destination;
+    }
+
+    // the payload checksum is computed again only if the frame gets another size,
+    // the header of --header changes with every frame, so it is added to the cached sum each time
+    uint8_t *payload = frame + worker->packet_headers_size;
+    size_t size = worker_next_size(worker);
+    worker_frame_t *cached = &worker->packet_frames[slot];
+    if (cached->size != size) {
+      cached->size = size;
+      cached->sum = packet_checksum_add(0, payload + header_size, size - header_size);
+    }
+
+    uint32_t sum = cached->sum;
+    if (g_arg_is_header) {
+      probe_write(payload, worker->index, worker->header_sequences[worker->source_index]++, time_ns);
+      sum = packet_checksum_add(sum, payload, PROBE_HEADER_SIZE);
+    }
+
+    packet_ring_commit(&worker->packet, packet_patch_headers(frame, &sockaddr, size, sum));
+
+    ++worker->packet_pending;
+    worker->packet_pending_bytes += size;
+  }
+
+  if (worker->packet_pending > 0) {
+    // frames left pending by a full ring were recorded in the pass which wrote them, only new ones are recorded,
+    // the send latency of all pending frames is recorded once the kernel takes them
+    uint64_t submit_ns = uv_hrtime();
+    worker_record_latency(&worker->stats->schedule_latency, worker->scheduled_ns, submit_ns, index);
+
+    int err = packet_ring_flush(&worker->packet);
+    stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+    if (0 == err) {
+      stats_counter_add(&worker->stats->sent_operations, worker->packet_pending);
+      stats_counter_add(&worker->stats->sent_fragments, worker->packet_pending);
+      stats_counter_add(&worker->stats->sent_messages, worker->packet_pending);
+      stats_counter_add(&worker->stats->sent_bytes, worker->packet_pending_bytes);
+      worker_record_latency(&worker->stats->send_latency, submit_ns, uv_hrtime(), worker->packet_pending);
+
+      logger_print_trace("#%d: Sent %u frames\n", worker->index, worker->packet_pending);
+
+      worker->packet_pending = 0;
+      worker->packet_pending_bytes = 0;
+    } else if (UV_EAGAIN != err && UV_ENOBUFS != err) {
+      logger_print_error("#%d: send(packet) failed: %s\n", worker->index, uv_strerror(err));
+      stats_counter_add(&worker->stats->sent_errors, 1);
+      return;
+    }
+  }
+
+  if (index < count) {
+    // the ring is full, the socket becomes writable when the kernel releases sent frames
+    int err = uv_poll_start(&worker->packet_poll, UV_WRITABLE, worker_packet_poll);
+    if (err) {
+      logger_print_error("#%d: uv_poll_start failed: %s\n", worker->index, uv_strerror(err));
+    }
+    return;
+  }
+
+  worker_schedule_send(worker);
+}
+
+static void worker_pace_init(worker_p worker) {
+  assert(NULL != worker);
+
+  worker->pace_timerfd = -1;
+
+  bool is_rate_limited = rate_bucket_is_limited(&g_rate_operations) || rate_bucket_is_limited(&g_rate_bytes);
+  if (0 == g_arg_gap_ns && !is_rate_limited) {
+    return;
+  }
+
+  // without the timerfd waits fall back to the uv timer and spin for the rest of the millisecond
+  int err = pacer_timer_init(&worker->pace_timerfd);
+  if (err) {
+    logger_print_error("#%d: timerfd_create failed: %s\n", worker->index, uv_strerror(err));
+    return;
+  }
+
+  err = uv_poll_init(worker->loop, &worker->pace_poll, worker->pace_timerfd);
+  if (err) {
+    logger_print_error("#%d: uv_poll_init failed: %s\n", worker->index, uv_strerror(err));
+    pacer_timer_term(worker->pace_timerfd);
+    worker->pace_timerfd = -1;
+    return;
+  }
+  uv_handle_set_data((uv_handle_t *)&worker->pace_poll, worker_retain(worker));
+
+  err = uv_poll_start(&worker->pace_poll, UV_READABLE, worker_pace_poll);
+  if (err) {
+    logger_print_error("#%d: uv_poll_start failed: %s\n", worker->index, uv_strerror(err));
+    uv_close((uv_handle_t *)&worker->pace_poll, worker_handle_closed);
+    pacer_timer_term(worker->pace_timerfd);
+    worker->pace_timerfd = -1;
+    return;
+  }
+}
+
+static void worker_pace_term(worker_p worker) {
+  assert(NULL != worker);
+
+  if (worker->pace_timerfd < 0) {
+    return;
+  }
+
+  uv_close((uv_handle_t *)&worker->pace_poll, worker_handle_closed);
+  pacer_timer_term(worker->pace_timerfd);
+  worker->pace_timerfd = -1;
+}
+
+static void worker_pace_poll(uv_poll_t *poll, int status, int events) {
+  assert(NULL != poll);
+  (void)events;
+
+  worker_p worker = (worker_p)uv_handle_get_data((uv_handle_t *)poll);
+  assert(NULL != worker);
+
+  if (worker_is_stopped(worker)) {
+    return;
+  }
+
+  if (status) {
+    logger_print_error("#%d: uv_poll failed: %s\n", worker->index, uv_strerror(status));
+    return;
+  }
+
+  pacer_timer_clear(worker->pace_timerfd);
+  worker_async_send(&worker->send);
+}
+
+static void worker_busy_proc(worker_p worker) {
+  assert(NULL != worker);
+  assert(0 != worker->index);
+
+  worker_retain(worker);
+
+  if (!worker_prepare(worker)) {
+    worker_set_state(worker, worker_state_failed);
+    worker_release(worker);
+    return;
+  }
+
+  // the loop waits for the sockets itself, so it gets plain descriptors instead of libuv handles
+  if (!worker_sources_open(worker, SOCK_NONBLOCK)) {
+    worker_set_state(worker, worker_state_failed);
+    worker_release(worker);
+    return;
+  }
+
+  worker_sources_configure(worker);
+
+  if (g_arg_gso > 1) {
+    worker_set_gso(worker, (unsigned int)g_arg_gso);
+  }
+
+  worker_set_state(worker, worker_state_ready);
+
+  while (!custom_atomic_load(&worker->is_stopping)) {
+    if (!worker_busy_send(worker)) {
+      break;
+    }
+  }
+
+  int index = 0;
+  for (index = 0; index < g_arg_source_ports; ++index) {
+    close(worker->source_fds[index]);
+  }
+
+  worker_set_state(worker, worker_state_stopped);
+  worker_release(worker);
+}
+
+static bool worker_busy_send(worker_p worker) {
+  assert(NULL != worker);
+
+  // rate limits and gaps are spun, the thread does nothing else
+  uint64_t time_ns = uv_hrtime();
+  uint64_t operations_due_ns = rate_account_take(&worker->rate_operations, &g_rate_operations,
+                                                 custom_atomic_load_relaxed(&worker->stats->sent_operations), time_ns);
+  uint64_t bytes_due_ns =
+      rate_account_take(&worker->rate_bytes, &g_rate_bytes, custom_atomic_load_relaxed(&worker->stats->sent_bytes), time_ns);
+
+  uint64_t due_ns = (operations_due_ns > bytes_due_ns) ? operations_due_ns : bytes_due_ns;
+  uint64_t scheduled_ns = (due_ns > time_ns) ? due_ns : 0;
+  if (0 != g_arg_gap_ns) {
+    if (0 == worker->gap_next_ns) {
+      worker->gap_next_ns = time_ns;
+    }
+
+    due_ns = (worker->gap_next_ns > due_ns) ? worker->gap_next_ns : due_ns;
+    scheduled_ns = due_ns;
+  }
+
+  if (!worker_busy_wait(worker, due_ns)) {
+    return true;
+  }
+
+  // the whole batch leaves from one socket, the next batch takes the next one
+  worker_next_source(worker);
+
+  unsigned int count = (unsigned int)g_arg_batch;
+  worker_fill_batch(worker, count);
+
+  uint64_t submit_ns = uv_hrtime();
+  worker_record_latency(&worker->stats->schedule_latency, (0 != scheduled_ns) ? scheduled_ns : time_ns, submit_ns,
+                        count);
+
+  int sent = 0;
+  if (1 == count) {
+    ssize_t length = sendmsg(worker->fd, &worker->batch_messages[0].msg_hdr, worker->send_flags);
+    sent = (length < 0) ? -1 : 1;
+  } else {
+    sent = sendmmsg(worker->fd, worker->batch_messages, count, worker->send_flags);
+  }
+  stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+  // the error is kept before the drain, which always ends with a failed recvmsg
+  int err = (sent < 0) ? uv_translate_sys_error(errno) : 0;
+  if (MSG_ZEROCOPY & worker->send_flags) {
+    worker_zerocopy_drain(worker);
+  }
+
+  if (sent < 0) {
+    if (UV_EAGAIN == err || UV_ENOBUFS == err) {
+      // the socket buffer is full and the datagrams of the batch are dropped, the timeout lets the loop see the stop flag
+      stats_counter_add(&worker->stats->sent_errors, count);
+      struct pollfd descriptor = {worker->fd, POLLOUT, 0};
+      while (poll(&descriptor, 1, BUSY_POLL_TIMEOUT_MS) < 0 && EINTR == errno) {
+      }
+
+      return true;
+    } else if (worker_is_gso_refused(worker, err)) {
+      return true;
+    }
+
+    logger_print_error("#%d: %s failed: %s\n", worker->index, (1 == count) ? "sendmsg" : "sendmmsg", uv_strerror(err));
+    stats_counter_add(&worker->stats->sent_errors, 1);
+    return false;
+  }
+
+  // unsent datagrams of a batch are dropped and counted as failures, the next batch gets new destinations and payloads
+  worker_account_batch(worker, 0, (unsigned int)sent);
+  stats_counter_add(&worker->stats->sent_errors, count - (unsigned int)sent);
+  worker_record_latency(&worker->stats->send_latency, submit_ns, uv_hrtime(), (size_t)sent);
+
+  if (0 != g_arg_gap_ns) {
+    worker_advance_gap(worker);
+  }
+
+  return true;
+}
+
+static bool worker_busy_wait(worker_p worker, uint64_t due_ns) {
+  assert(NULL != worker);
+
+  while (uv_hrtime() < due_ns) {
+    if (custom_atomic_load(&worker->is_stopping)) {
+      return false;
+    }
+
+    custom_atomic_cpu_relax();
+  }
+
+  return true;
+}
+
+static void worker_packet_poll(uv_poll_t *poll, int status, int events) {
+  assert(NULL != poll);
+  (void)events;
+
+  worker_p worker = (worker_p)uv_handle_get_data((uv_handle_t *)poll);
+  assert(NULL != worker);
+
+  uv_poll_stop(poll);
+
+  if (worker_is_stopped(worker)) {
+    return;
+  }
+
+  if (status) {
+    logger_print_error("#%d: uv_poll failed: %s\n", worker->index, uv_strerror(status));
+    return;
+  }
+
+  worker_async_send(&worker->send);
+}
+
+static bool worker_sink_init(worker_p worker) {
+  assert(NULL != worker);
+
+  worker->sink_socket = -1;
+
+  // the sink does not receive on the libuv socket, recvmmsg drains its own non-blocking socket
+  worker->sink_socket = socket(g_arg_is_ipv4 ? AF_INET : AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (worker->sink_socket < 0) {
+    logger_print_error("#%d: socket failed: %s\n", worker->index, uv_strerror(uv_translate_sys_error(errno)));
+    return false;
+  }
+
+  // the kernel spreads the flows between the workers which share the port
+  int value = 1;
+  if (setsockopt(worker->sink_socket, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value)) < 0) {
+    logger_print_error("#%d: setsockopt(SO_REUSEPORT) failed: %s\n", worker->index,
+                       uv_strerror(uv_translate_sys_error(errno)));
+    worker_sink_term(worker);
+    return false;
+  }
+
+  sockaddr_any address;
+  worker_next_destination(worker, &address);
+
+  char address_str[64] = {0};
+  address_format(&address, address_str, sizeof(address_str));
+
+  socklen_t address_length = g_arg_is_ipv4 ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+  if (bind(worker->sink_socket, &address.addr, address_length) < 0) {
+    logger_print_error("#%d: bind(%s) failed: %s\n", worker->index, address_str,
+                       uv_strerror(uv_translate_sys_error(errno)));
+    worker_sink_term(worker);
+    return false;
+  }
+
+  worker->sink_buffers = (uint8_t *)malloc((size_t)g_arg_batch * WORKER_SINK_BUFFER_SIZE);
+  if (NULL == worker->sink_buffers) {
+    logger_print_error("#%d: malloc failed: %s\n", worker->index, uv_strerror(ENOMEM));
+    worker_sink_term(worker);
+    return false;
+  }
+
+  int err = probe_flows_init(&worker->sink_flows);
+  if (err) {
+    logger_print_error("#%d: calloc failed: %s\n", worker->index, uv_strerror(err));
+    worker_sink_term(worker);
+    return false;
+  }
+
+  // the headers are built once, recvmmsg changes only the lengths and the flags
+  unsigned int index = 0;
+  for (index = 0; index < (unsigned int)g_arg_batch; ++index) {
+    worker->batch_iovecs[index].iov_base = worker->sink_buffers + (size_t)index * WORKER_SINK_BUFFER_SIZE;
+    worker->batch_iovecs[index].iov_len = WORKER_SINK_BUFFER_SIZE;
+
+    struct msghdr *header = &worker->batch_messages[index].msg_hdr;
+    header->msg_name = &worker->batch_sockaddrs[index];
+    header->msg_iov = &worker->batch_iovecs[index];
+    header->msg_iovlen = 1;
+  }
+
+  err = uv_poll_init(worker->loop, &worker->sink_poll, worker->sink_socket);
+  if (err) {
+    logger_print_error("#%d: uv_poll_init failed: %s\n", worker->index, uv_strerror(err));
+    worker_sink_term(worker);
+    return false;
+  }
+  uv_handle_set_data((uv_handle_t *)&worker->sink_poll, worker_retain(worker));
+
+  err = uv_poll_start(&worker->sink_poll, UV_READABLE, worker_sink_poll);
+  if (err) {
+    logger_print_error("#%d: uv_poll_start failed: %s\n", worker->index, uv_strerror(err));
+    worker_sink_term(worker);
+    return false;
+  }
+
+  logger_print_trace("#%d: Receiving on %s\n", worker->index, address_str);
+  return true;
+}
+
+static void worker_sink_term(worker_p worker) {
+  assert(NULL != worker);
+
+  if (NULL != uv_handle_get_data((uv_handle_t *)&worker->sink_poll)) {
+    uv_close((uv_handle_t *)&worker->sink_poll, worker_handle_closed);
+  }
+
+  if (worker->sink_socket >= 0) {
+    close(worker->sink_socket);
+    worker->sink_socket = -1;
+  }
+
+  if (NULL == worker->sink_flows.flows) {
+    return;
+  }
+
+  // the flows are summarized once, the stats show only the sums of all flows
+  size_t index = 0;
+  for (index = 0; index < PROBE_FLOWS_CAPACITY; ++index) {
+    const probe_flow_t *flow = &worker->sink_flows.flows[index];
+    if (!flow->is_used) {
+      continue;
+    }
+
+    char source_str[64] = {0};
+    address_format(&flow->source, source_str, sizeof(source_str));
+
+    logger_print_info("#%d: Flow of worker %u from %s, %" PRIu64 " received, %" PRIu64 " missing, %" PRIu64
+                      " reordered up to %" PRIu64 " behind, %" PRIu64 " duplicates, %" PRIu64 " late\n",
+                      worker->index, flow->worker, source_str, flow->received, probe_flow_missing(flow), flow->reordered,
+                      flow->reorder_depth, flow->duplicates, flow->late);
+
+    logger_print_info("#%d: Flow of worker %u from %s, latency min %" PRIu64 " ns, avg %" PRIu64 " ns, max %" PRIu64
+                      " ns\n",
+                      worker->index, flow->worker, source_str, flow->latency_minimum,
+                      flow->latency_sum / flow->latency_count, flow->latency_maximum);
+  }
+
+  if (0 != worker->sink_flows.untracked) {
+    logger_print_info("#%d: %" PRIu64 " datagrams of more than %d flows were not tracked\n", worker->index,
+                      worker->sink_flows.untracked, PROBE_FLOWS_CAPACITY);
+  }
+
+  probe_flows_term(&worker->sink_flows);
+}
+
+static void worker_sink_poll(uv_poll_t *poll, int status, int events) {
+  assert(NULL != poll);
+  (void)events;
+
+  worker_p worker = (worker_p)uv_handle_get_data((uv_handle_t *)poll);
+  assert(NULL != worker);
+
+  if (worker_is_stopped(worker)) {
+    return;
+  }
+
+  if (status) {
+    logger_print_error("#%d: uv_poll failed: %s\n", worker->index, uv_strerror(status));
+    return;
+  }
+
+  unsigned int count = (unsigned int)g_arg_batch;
+
+  // the poll is level-triggered, datagrams left after the last round wake the worker again
+  int round = 0;
+  for (round = 0; round < SINK_ROUNDS; ++round) {
+    unsigned int index = 0;
+    for (index = 0; index < count; ++index) {
+      worker->batch_messages[index].msg_hdr.msg_namelen = sizeof(worker->batch_sockaddrs[index]);
+    }
+
+    int received = recvmmsg(worker->sink_socket, worker->batch_messages, count, MSG_DONTWAIT | MSG_TRUNC, NULL);
+    stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+    if (received < 0) {
+      if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno) {
+        logger_print_error("#%d: recvmmsg failed: %s\n", worker->index, uv_strerror(uv_translate_sys_error(errno)));
+        stats_counter_add(&worker->stats->sent_errors, 1);
+      }
+      return;
+    }
+
+    uint64_t time_ns = uv_hrtime();
+
+    // with MSG_TRUNC the length is the size of the datagram, not the part of it in the buffer
+    size_t bytes = 0;
+    for (index = 0; index < (unsigned int)received; ++index) {
+      size_t size = worker->batch_messages[index].msg_len;
+      bytes += size;
+
+      // datagrams without the header are only counted
+      probe_header_t header;
+      const uint8_t *buffer = (const uint8_t *)worker->batch_iovecs[index].iov_base;
+      if (!probe_read(buffer, (size < WORKER_SINK_BUFFER_SIZE) ? size : WORKER_SINK_BUFFER_SIZE, &header)) {
+        continue;
+      }
+
+      probe_flows_record(&worker->sink_flows, &worker->batch_sockaddrs[index], &header, time_ns);
+      worker_record_latency(&worker->stats->probe_latency, header.time_ns, time_ns, 1);
+    }
+
+    stats_counter_add(&worker->stats->sent_operations, (size_t)received);
+    stats_counter_add(&worker->stats->sent_messages, (size_t)received);
+    stats_counter_add(&worker->stats->sent_bytes, bytes);
+    custom_atomic_store_relaxed(&worker->stats->probe_missing, (size_t)worker->sink_flows.missing);
+    custom_atomic_store_relaxed(&worker->stats->probe_reordered, (size_t)worker->sink_flows.reordered);
+    custom_atomic_store_relaxed(&worker->stats->probe_duplicates, (size_t)worker->sink_flows.duplicates);
+
+    if (g_arg_is_reflect) {
+      worker_sink_reflect(worker, (unsigned int)received);
+    }
+
+    if ((unsigned int)received < count) {
+      return;
+    }
+  }
+}
+
+static void worker_sink_reflect(worker_p worker, unsigned int count) {
+  assert(NULL != worker);
+
+  // the received messages are sent back as they are, their names are the sources
+  unsigned int index = 0;
+  for (index = 0; index < count; ++index) {
+    size_t size = worker->batch_messages[index].msg_len;
+    worker->batch_iovecs[index].iov_len = (size < WORKER_SINK_BUFFER_SIZE) ? size : WORKER_SINK_BUFFER_SIZE;
+  }
+
+  int sent = sendmmsg(worker->sink_socket, worker->batch_messages, count, MSG_DONTWAIT);
+  stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+  // a full socket buffer drops the replies, the sender sees them as lost
+  if (sent < 0) {
+    if (EAGAIN != errno && EWOULDBLOCK != errno && ENOBUFS != errno) {
+      logger_print_trace("#%d: sendmmsg failed: %s\n", worker->index, uv_strerror(uv_translate_sys_error(errno)));
+    }
+    sent = 0;
+  }
+
+  if ((unsigned int)sent < count) {
+    stats_counter_add(&worker->stats->sent_errors, count - (unsigned int)sent);
+  }
+
+  for (index = 0; index < count; ++index) {
+    worker->batch_iovecs[index].iov_len = WORKER_SINK_BUFFER_SIZE;
+  }
+}
+#endif /*PLATFORM_LINUX*/
+
+static void worker_schedule_send(worker_p worker) {
+  assert(NULL != worker);
+
+  if (0 == g_arg_timeout_ms) {
+    int err = uv_async_send(&worker->send);
+    if (err) {
+      logger_print_error("#%d: uv_async_send failed: %s\n", worker->index, uv_strerror(err));
+      return;
+    }
+  } else if (!uv_is_active((uv_handle_t *)&worker->wait)) {
+    // the timer refills all free slots at once
+    logger_print_trace("#%d: Waiting for %dms\n", worker->index, g_arg_timeout_ms);
+
+    int err = uv_timer_start(&worker->wait, worker_timer_timeout, g_arg_timeout_ms, 0);
+    if (err) {
+      logger_print_error("#%d: uv_timer_start failed: %s\n", worker->index, uv_strerror(err));
+      return;
+    }
+  }
+}
+
+static bool worker_wait_rate(worker_p worker) {
+  assert(NULL != worker);
+
+  if (!rate_bucket_is_limited(&g_rate_operations) && !rate_bucket_is_limited(&g_rate_bytes)) {
+    return false;
+  }
+
+  // the worker pays for the sends that are already counted, in-flight sends are paid after their completion
+  uint64_t time_ns = uv_hrtime();
+  uint64_t operations_due_ns = rate_account_take(&worker->rate_operations, &g_rate_operations,
+                                                 custom_atomic_load_relaxed(&worker->stats->sent_operations), time_ns);
+  uint64_t bytes_due_ns =
+      rate_account_take(&worker->rate_bytes, &g_rate_bytes, custom_atomic_load_relaxed(&worker->stats->sent_bytes), time_ns);
+
+  uint64_t due_ns = (operations_due_ns > bytes_due_ns) ? operations_due_ns : bytes_due_ns;
+  if (due_ns <= time_ns) {
+    return false;
+  }
+
+  return worker_wait_until(worker, due_ns);
+}
+
+static bool worker_wait_gap(worker_p worker) {
+  assert(NULL != worker);
+
+  if (0 == g_arg_gap_ns) {
+    return false;
+  }
+
+  if (0 == worker->gap_next_ns) {
+    worker->gap_next_ns = uv_hrtime();
+  }
+
+  if (worker_wait_until(worker, worker->gap_next_ns)) {
+    return true;
+  }
+
+  worker_advance_gap(worker);
+  return false;
+}
+
+static void worker_advance_gap(worker_p worker) {
+  assert(NULL != worker);
+
+  // a late send does not move the following ones, so errors do not drift
+  uint64_t time_ns = uv_hrtime();
+  worker->gap_next_ns += g_arg_gap_ns;
+  if (worker->gap_next_ns + PACER_MAXIMAL_LAG_NS < time_ns) {
+    worker->gap_next_ns = time_ns;
+  }
+}
+
+static bool worker_wait_until(worker_p worker, uint64_t due_ns) {
+  assert(NULL != worker);
+
+  // returns false if the worker is already at due_ns and true if it should return to the loop
+  if (due_ns > worker->pace_due_ns) {
+    worker->pace_due_ns = due_ns;
+  }
+
+  uint64_t time_ns = uv_hrtime();
+  if (due_ns <= time_ns + PACER_SPIN_NS) {
+    pacer_spin_until(due_ns);
+    return false;
+  }
+
+#if defined(PLATFORM_LINUX)
+  if (worker->pace_timerfd >= 0) {
+    int err = pacer_timer_arm(worker->pace_timerfd, due_ns - PACER_SPIN_NS);
+    if (0 == err) {
+      return true;
+    }
+
+    logger_print_error("#%d: timerfd_settime failed: %s\n", worker->index, uv_strerror(err));
+  }
+#endif /*PLATFORM_LINUX*/
+
+  if (!uv_is_active((uv_handle_t *)&worker->wait)) {
+    // the uv timer has millisecond resolution, it fires before the deadline and the rest of the wait is spun
+    uv_update_time(worker->loop);
+
+    uint64_t timeout_ms = (due_ns - PACER_SPIN_NS - time_ns) / 1000000;
+    int err = uv_timer_start(&worker->wait, worker_timer_timeout, timeout_ms, 0);
+    if (err) {
+      logger_print_error("#%d: uv_timer_start failed: %s\n", worker->index, uv_strerror(err));
+    }
+  }
+
+  return true;
+}
+
+static void worker_request_send_completed(uv_udp_send_t *req, int status) {
+  assert(NULL != req);
+
+  worker_slot_p slot = (worker_slot_p)uv_req_get_data((uv_req_t *)req);
+  assert(NULL != slot);
+
+  worker_p worker = slot->worker;
+  assert(NULL != worker);
+
+  stats_counter_sub(&worker->stats->sent_inflight, 1);
+  if (NULL != slot->connection) {
+    --slot->connection->inflight;
+  }
+  worker_return_slot(worker, slot);
+
+  if (worker_is_stopped(worker) || UV_ECANCELED == status) {
+    worker_release(worker);
+    return;
+  }
+
+#if defined(PLATFORM_LINUX)
+  if (worker_is_gso_refused(worker, status)) {
+    // the rest of the batch was built for GSO, so the next batch is built again
+    worker->batch_offset = 0;
+    worker_schedule_send(worker);
+    worker_release(worker);
+    return;
+  }
+#endif /*PLATFORM_LINUX*/
+
+  // a failed send does not stop the worker, the next one could succeed
+  if (status) {
+    logger_print_trace("#%d: uv_udp_send(%s) failed: %s\n", worker->index, slot->address, uv_strerror(status));
+    stats_counter_add(&worker->stats->sent_errors, 1);
+  } else {
+    stats_counter_add(&worker->stats->sent_operations, worker_count_datagrams(worker, slot->size));
+    stats_counter_add(&worker->stats->sent_fragments, worker_count_fragments(worker, slot->size));
+    stats_counter_add(&worker->stats->sent_messages, 1);
+    stats_counter_add(&worker->stats->sent_bytes, slot->size);
+    worker_record_latency(&worker->stats->send_latency, slot->submit_ns, uv_hrtime(), 1);
+  }
+
+  stats_counter_add(&worker->stats->sent_syscalls, 1);
+
+#if defined(PLATFORM_LINUX)
+  if (0 != worker->batch_offset) {
+    // the rest of the batch is due with the batch, the timeout and the pacing are applied between batches
+    worker_send_batch(worker);
+    worker_release(worker);
+    return;
+  }
+#endif /*PLATFORM_LINUX*/
+
+  if (0 == g_arg_timeout_ms) {
+    // the pipeline is refilled right away instead of waiting for the next loop iteration
+    worker_async_send(&worker->send);
+  } else {
+    worker_schedule_send(worker);
+  }
+
+  worker_release(worker);
+}
+
+static void worker_reply_alloc(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf) {
+  assert(NULL != handle);
+  assert(NULL != buf);
+  (void)suggested_size;
+
+  worker_p worker = (worker_p)uv_handle_get_data(handle);
+  assert(NULL != worker);
+
+  *buf = uv_buf_init((char *)worker->reply_buffer, sizeof(worker->reply_buffer));
+}
+
+static void worker_reply_received(uv_udp_t *socket, ssize_t nread, const uv_buf_t *buf, const struct sockaddr *addr,
+                                  unsigned int flags) {
+  assert(NULL != socket);
+  assert(NULL != buf);
+  (void)addr;
+  (void)flags;
+
+  worker_p worker = (worker_p)uv_handle_get_data((uv_handle_t *)socket);
+  assert(NULL != worker);
+
+  if (nread < 0) {
+    logger_print_trace("#%d: uv_udp_recv failed: %s\n", worker->index, uv_strerror((int)nread));
+    return;
+  }
+
+  // only replies of this worker have its send times, other datagrams are ignored
+  probe_header_t header;
+  if (!probe_read((const uint8_t *)buf->base, (size_t)nread, &header) || header.worker != worker->index) {
+    return;
+  }
+
+  worker_record_latency(&worker->stats->rtt_latency, header.time_ns, uv_hrtime(), 1);
+}
+
+static void worker_record_latency(histogram_t *histogram, uint64_t from_ns, uint64_t to_ns, size_t count) {
+  assert(NULL != histogram);
+
+  if (0 == count) {
+    return;
+  }
+
+  // sends wait for their deadlines, the check only keeps a broken clock from wrapping the value
+  histogram_record(histogram, (to_ns > from_ns) ? (to_ns - from_ns) : 0, count);
 }
@@ -3,6 +3,9 @@
 #include <stdbool.h>
 #include <uv.h>
 
+// the sink keeps only the beginning of each datagram, MSG_TRUNC still reports the whole size
+#define WORKER_SINK_BUFFER_SIZE 2048
+
 typedef struct _worker_t *worker_p;
 
 extern worker_p worker_create_in_loop(uv_loop_t *loop, unsigned int index);